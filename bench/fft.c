@@ -0,0 +1,85 @@
+// Builds against the whole of fft.c to time the algorithms side by side,
+// the cache would only hand out the one picked for the size
+#include "../src/fft.c"
+
+#define LOG2_MIN 16	// FFT_FOURSTEP_MIN
+#define LOG2_MAX 22
+
+static const int threads[] = {1, 2, 4, 8, 16};
+
+#define NTHREADS ((int)(sizeof (threads) / sizeof (threads[0])))
+
+
+// ms per transform of a private plan of the algorithm
+static double
+algo_time(int n, enum fft_algo algo, float *rex, float *imx)
+{
+	int ok;
+	double t;
+	struct fft_plan plan;
+
+	// sub plans come from the cache
+	pthread_mutex_lock(&plans_lock);
+	if (best_kernel == -1)
+		best_kernel = kernel_detect();
+	ok = (plan_init(&plan, n, algo) == 0);
+	pthread_mutex_unlock(&plans_lock);
+
+	if (!ok)
+		error(1, "Can't build a %s plan of %d", algo_names[algo], n);
+
+	t = plan_time(&plan, rex, imx) * 1e3;
+	plan_fini(&plan);
+
+	return t;
+}
+
+int
+main(void)
+{
+	int i, b;
+	int n = 1 << LOG2_MAX;
+	double radix2[LOG2_MAX + 1];
+	double fourstep[NTHREADS][LOG2_MAX + 1];
+	float *rex, *imx;
+
+	rex = xmalloc(2 * n * sizeof (float));
+	imx = rex + n;
+	for (i = 0; i < 2 * n; ++i)
+		rex[i] = (float)rand() / RAND_MAX - 0.5f;
+
+	// radix-2 runs on the caller alone
+	for (b = LOG2_MIN; b <= LOG2_MAX; ++b)
+		radix2[b] = algo_time(1 << b, FFT_ALGO_RADIX2, rex, imx);
+
+	for (i = 0; i < NTHREADS; ++i) {
+		fft_set_pool(pool_new(threads[i]));
+
+		for (b = LOG2_MIN; b <= LOG2_MAX; ++b)
+			fourstep[i][b] = algo_time(1 << b, FFT_ALGO_FOURSTEP,
+			    rex, imx);
+	}
+
+	printf("complex FFT ms, four-step with 1 to %d threads against "
+	    "radix-2 (%s)\n", threads[NTHREADS - 1],
+	    fft_kernel_name(best_kernel));
+	printf("%8s  %8s", "n", "radix2");
+	for (i = 0; i < NTHREADS; ++i)
+		printf("  %6s%-2d", "4step/", threads[i]);
+	printf("  speedup\n");
+
+	for (b = LOG2_MIN; b <= LOG2_MAX; ++b) {
+		double best = HUGE_VAL;
+
+		printf("%8d  %8.3f", 1 << b, radix2[b]);
+		for (i = 0; i < NTHREADS; ++i) {
+			printf("  %8.3f", fourstep[i][b]);
+			best = MIN(best, fourstep[i][b]);
+		}
+		printf("  %7.2f\n", radix2[b] / best);
+	}
+
+	free(rex);
+
+	return 0;
+}
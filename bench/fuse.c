@@ -0,0 +1,131 @@
+// Runs the engine's own node code, so it builds against the whole of
+// wind.c like the program does
+#define NK_IMPLEMENTATION
+#include "../src/wind.c"
+
+#define SAMPLES 4096
+#define PASSES 4000
+
+static const int lengths[] = {2, 4, 8, 16};
+
+struct chain {
+	struct node *src;
+	struct node *stages[16];
+	int nstages;
+};
+
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// sine -> gain -> clamp -> gain ... -> plot
+static void
+chain_new(struct chain *c, int nstages)
+{
+	int i;
+	struct node *from, *node;
+
+	c->src = node_new(WIND_GEN_SIN);
+	c->src->sine_samples = SAMPLES;
+	c->nstages = nstages;
+
+	from = c->src;
+	for (i = 0; i < nstages; ++i) {
+		node = node_new((i % 2 == 0) ? WIND_GAIN : WIND_CLAMP);
+		node->amp = 1.25f;
+		node->limit = 0.75f;
+
+		link_add(from, 0, node, 0);
+		c->stages[i] = node;
+		from = node;
+	}
+
+	link_add(from, 0, node_new(WIND_PLOT), 0);
+}
+
+// us per pass over the chain; fused runs the tail alone, the others each
+// stage over the whole buffer
+static double
+chain_time(struct chain *c, int fused)
+{
+	int i, p;
+	double t;
+
+	graph_compile();
+
+	if (!fused) {
+		for (i = 0; i < c->nstages; ++i) {
+			c->stages[i]->fuse_from = NULL;
+			c->stages[i]->fused = 0;
+		}
+
+		graph_alloc();
+	}
+
+	node_run(c->src);
+
+	t = now();
+	for (p = 0; p < PASSES; ++p) {
+		if (fused)
+			node_run(c->stages[c->nstages - 1]);
+		else
+			for (i = 0; i < c->nstages; ++i)
+				node_run(c->stages[i]);
+	}
+
+	return (now() - t) / PASSES * 1e6;
+}
+
+int
+main(void)
+{
+	int i, n, kb;
+	size_t size = SAMPLES * sizeof (float);
+	float *ref;
+	double tu, tf;
+	struct chain c;
+	struct connector *out;
+
+	wind_nodes = list_new(wind_nodes);
+	wind_nodes->type = WIND_MENU;
+	wind_nodes->icon = wind_nodes->ocon = 0;
+	wind_nodes->inp = wind_nodes->out = NULL;
+	wind_nodes->ilink = wind_nodes->olink = NULL;
+	wind_nodes->inp_version = NULL;
+	nodecount = 1;
+	oss_fd = -1;
+
+	ref = xmalloc(size);
+
+	printf("Gain/Clamp chains of %d samples, %d passes\n", SAMPLES,
+	    PASSES);
+	printf("stages  unfused us  fused us  speedup  "
+	    "touched KB unfused/fused  same\n");
+
+	for (i = 0; i < (int)(sizeof (lengths) / sizeof (lengths[0])); ++i) {
+		n = lengths[i];
+		chain_new(&c, n);
+		out = c.stages[n - 1]->out[0];
+
+		tu = chain_time(&c, 0);
+		memcpy(ref, out->buf, size);
+
+		tf = chain_time(&c, 1);
+
+		// a pass touches the input and every stage's output, fused
+		// only the input and the tail's output
+		kb = SAMPLES * sizeof (float) / 1024;
+		printf("%6d  %10.2f  %8.2f  %7.2f  %13d/%d  %9s\n", n, tu, tf,
+		    tu / tf, (n + 1) * kb, 2 * kb,
+		    memcmp(ref, out->buf, size) ? "no" : "yes");
+	}
+
+	return 0;
+}
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "fft.h"
+#include "pool.h"
+#include "macro.h"
+
+// independent chains of real FFT nodes, as signal_proc hands them over
+#define CHAINS 16
+#define DEPTH 4
+#define SIZE 4096
+#define PASSES 50
+
+// one large transform per pass, its four-step split runs nested in the
+// graph task
+#define LARGE (1 << 18)
+#define LARGE_PASSES 10
+
+static const int threads[] = {1, 2, 4, 8, 16};
+
+struct bench {
+	struct fft_plan *plan;
+	float **in, **rex, **imx;
+};
+
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+task(void *arg, int i)
+{
+	struct bench *b = arg;
+
+	fft_exec_real(b->plan, b->in[i], b->rex[i], b->imx[i]);
+}
+
+static void
+bench_new(struct bench *b, int count, int n)
+{
+	int i, j;
+
+	b->plan = fft_plan_get(n);
+	b->in = xmalloc(count * sizeof (float*));
+	b->rex = xmalloc(count * sizeof (float*));
+	b->imx = xmalloc(count * sizeof (float*));
+
+	for (i = 0; i < count; ++i) {
+		b->in[i] = xmalloc(n * sizeof (float));
+		b->rex[i] = xmalloc(n/2 * sizeof (float));
+		b->imx[i] = xmalloc(n/2 * sizeof (float));
+
+		for (j = 0; j < n; ++j)
+			b->in[i][j] = (float)rand() / RAND_MAX - 0.5f;
+	}
+}
+
+static void
+bench_free(struct bench *b, int count)
+{
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		free(b->in[i]);
+		free(b->rex[i]);
+		free(b->imx[i]);
+	}
+
+	free(b->in);
+	free(b->rex);
+	free(b->imx);
+}
+
+// ms per pass of the graph
+static double
+run(struct pool *pool, int count, int n, int passes, const int *npred,
+    int *const *succ, const int *nsucc)
+{
+	int p;
+	double t;
+	struct bench b;
+
+	bench_new(&b, count, n);
+
+	// the first pass builds the plans
+	pool_graph(pool, count, npred, succ, nsucc, task, &b);
+
+	t = now();
+	for (p = 0; p < passes; ++p)
+		pool_graph(pool, count, npred, succ, nsucc, task, &b);
+	t = (now() - t) / passes * 1e3;
+
+	bench_free(&b, count);
+
+	return t;
+}
+
+// A process per thread count: the plan cache keeps the algorithm picked
+// for the first pool, and four-step is only picked for more than one thread
+static void
+measure(int nthreads, double *t)
+{
+	int i, j, k;
+	int count = CHAINS * DEPTH;
+	int npred[CHAINS * DEPTH], nsucc[CHAINS * DEPTH];
+	int succbuf[CHAINS * DEPTH];
+	int *succ[CHAINS * DEPTH];
+	int zero = 0;
+	int *none = NULL;
+	int fds[2];
+	pid_t pid;
+	struct pool *pool;
+
+	fflush(stdout);
+
+	if (pipe(fds) == -1 || (pid = fork()) == -1)
+		error(1, "Can't start the measurement");
+
+	if (pid != 0) {
+		close(fds[1]);
+		if (read(fds[0], t, 2 * sizeof (double)) != 2 * sizeof (double))
+			error(1, "Measurement with %d threads failed", nthreads);
+		close(fds[0]);
+		waitpid(pid, NULL, 0);
+		return;
+	}
+
+	// node j of a chain feeds node j + 1
+	for (i = 0; i < CHAINS; ++i) {
+		for (j = 0; j < DEPTH; ++j) {
+			k = i*DEPTH + j;
+
+			npred[k] = (j > 0);
+			nsucc[k] = (j < DEPTH - 1);
+			succbuf[k] = k + 1;
+			succ[k] = &succbuf[k];
+		}
+	}
+
+	pool = pool_new(nthreads);
+	fft_set_pool(pool);
+
+	t[0] = run(pool, count, SIZE, PASSES, npred, succ, nsucc);
+	t[1] = run(pool, 1, LARGE, LARGE_PASSES, &zero, &none, &zero);
+
+	if (write(fds[1], t, 2 * sizeof (double)) != 2 * sizeof (double))
+		exit(1);
+	exit(0);
+}
+
+int
+main(void)
+{
+	int i;
+	double t[2], base[2];
+
+	printf("%d chains of %d real FFTs of %d, and one of %d\n", CHAINS,
+	    DEPTH, SIZE, LARGE);
+	printf("threads  chains ms  speedup  large ms  speedup\n");
+
+	for (i = 0; i < (int)(sizeof (threads) / sizeof (threads[0])); ++i) {
+		measure(threads[i], t);
+
+		if (i == 0)
+			memcpy(base, t, sizeof (base));
+
+		printf("%7d  %9.3f  %7.2f  %8.3f  %7.2f\n", threads[i], t[0],
+		    base[0] / t[0], t[1], base[1] / t[1]);
+		fflush(stdout);
+	}
+
+	return 0;
+}
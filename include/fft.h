@@ -0,0 +1,96 @@
+#ifndef _FFT_H
+#define _FFT_H
+
+// SIMD kernels run the same butterflies as the scalar one, two stages per
+// pass.  Only the rounding differs (FMA contraction): for unit-scale input
+// the outputs stay within 1e-6 * log2(n) * max|X| of the scalar kernel.
+enum fft_kernel_type {
+	FFT_KERNEL_SCALAR,
+	FFT_KERNEL_SSE2,
+	FFT_KERNEL_AVX2,
+	FFT_KERNEL_AVX512,
+
+	FFT_KERNELS,
+};
+
+enum fft_algo {
+	FFT_ALGO_RADIX2,	// powers of two
+	FFT_ALGO_MIXED,		// products of 2, 3, 5 and 7
+	FFT_ALGO_BLUESTEIN,	// anything else, as a power of two convolution
+	FFT_ALGO_FOURSTEP,	// large sizes, as n1 x n2 sub transforms
+
+	FFT_ALGOS,
+};
+
+#define FFT_MAXFACTORS 32
+#define FFT_FOURSTEP_MIN 65536
+
+struct pool;
+
+struct fft_plan {
+	int n;
+	int log2n;
+	enum fft_algo algo;
+
+	float *twr;	// cos(2*pi*k/n), k < n
+	float *twi;	// -sin(2*pi*k/n), k < n
+
+	// radix-2
+	int nswaps;
+	int *swaps;	// bit-reversal permutation as (i, j) pairs, i < j
+	float *stwr;	// twiddles laid out per stage for the SIMD kernels
+	float *stwi;
+
+	enum fft_kernel_type kernel;
+
+	// mixed radix: (radix, remaining length) pairs, outermost first
+	int nfactors;
+	int factors[2*FFT_MAXFACTORS];
+
+	// bluestein
+	struct fft_plan *sub;	// power of two plan of the convolution
+	float *chr, *chi;	// chirp exp(-i*pi*k^2/n), k < n
+	float *bkr, *bki;	// transformed conjugate chirp, scaled by 1/sub->n
+
+	// four-step
+	struct fft_plan *p1, *p2;	// n = p1->n * p2->n
+	float *fwr, *fwi;		// w^(j*k) as p2->n rows of p1->n
+
+	struct fft_plan *half;	// n/2 plan of the real transforms, on first use
+};
+
+void fft_set_pool(struct pool *pool);
+struct fft_plan *fft_plan_get(int n);
+int fft_plan_set_kernel(struct fft_plan *plan, enum fft_kernel_type kernel);
+const char *fft_kernel_name(enum fft_kernel_type kernel);
+void fft_exec(struct fft_plan *plan, float *rex, float *imx);
+
+// Batches hold count frames back to back: frame k of an n point plan starts
+// at k*n, or at k*n/2 for the complex side of the real transforms.
+void fft_exec_batch(struct fft_plan *plan, float *rex, float *imx, int count);
+
+// Real transforms need an even n and keep n/2 bins; the real Nyquist bin is
+// packed into imx[0].  The inverse is unnormalized and uses rex/imx as
+// workspace.
+void fft_exec_real(struct fft_plan *plan, const float *in, float *rex, float *imx);
+void fft_exec_real_inv(struct fft_plan *plan, float *rex, float *imx, float *out);
+void fft_exec_real_batch(struct fft_plan *plan, const float *in, float *rex,
+    float *imx, int count);
+void fft_exec_real_inv_batch(struct fft_plan *plan, float *rex, float *imx,
+    float *out, int count);
+
+// Same with the n/2 bins interleaved as re, im pairs; the Nyquist bin is
+// packed into the imaginary part of bin 0 and the input is left untouched.
+void fft_exec_real_c(struct fft_plan *plan, const float *in, float *out);
+void fft_exec_real_inv_c(struct fft_plan *plan, const float *in, float *out);
+
+// The autotuner times every algorithm and kernel able to run the size of
+// each cached plan and records the fastest as wisdom; the cached plans may
+// run meanwhile.  fft_replan() then rebuilds them from the wisdom, while
+// none runs.  Loaded wisdom applies to the plans created afterwards.
+void fft_autotune(void);
+void fft_replan(void);
+int fft_wisdom_load(const char *path);
+int fft_wisdom_save(const char *path);
+
+#endif // _FFT_H
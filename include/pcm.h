@@ -0,0 +1,13 @@
+#ifndef _PCM_H
+#define _PCM_H
+
+#include <stdint.h>
+
+#define PCM_CHNLS_MAX 8
+
+// Converts frames of chnls interleaved samples to floats in [-1, 1], one
+// array per channel.  Vectorized for 1, 2, 4 and 8 channels.
+void pcm_deinterleave(const int16_t *src, int chnls, int frames,
+    float **dst);
+
+#endif // _PCM_H
@@ -0,0 +1,30 @@
+#ifndef _POLAR_H
+#define _POLAR_H
+
+// Maximum errors of the fast approximations, against float libm:
+//   |X|    relative 4e-4 (reciprocal square root estimate)
+//   |X|^2  exact, same as the precise mode
+//   dB     absolute 2e-3 dB (cubic log2 of the mantissa)
+//   phase  absolute 2e-3 rad (reciprocal estimate and quadratic arctangent)
+// The precise modes stay within a few float ulps.
+enum polar_mode {
+	POLAR_MAG,	// |X|
+	POLAR_POWER,	// |X|^2
+	POLAR_DB,	// 10*log10(|X|^2), clamped at POLAR_DB_MIN
+	POLAR_PHASE,	// atan2(im, re) in [-pi, pi]
+
+	POLAR_MODES,
+};
+
+#define POLAR_DB_MIN -200.0f
+
+const char *polar_mode_name(enum polar_mode mode);
+
+// Converts n complex values given as separate re and im arrays, or as
+// interleaved re, im pairs for the _c variant.
+void polar_exec(enum polar_mode mode, int fast, const float *re,
+    const float *im, float *out, int n);
+void polar_exec_c(enum polar_mode mode, int fast, const float *x, float *out,
+    int n);
+
+#endif // _POLAR_H
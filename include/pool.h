@@ -0,0 +1,23 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+struct pool;
+
+struct pool *pool_new(int nthreads);
+int pool_size(struct pool *pool);
+
+// Runs fn(arg, i) for i < count and returns when all of them are done.  The
+// caller takes part in the work, so this may be called from inside a job; a
+// NULL pool runs everything on the caller.
+void pool_for(struct pool *pool, int count, void (*fn)(void *arg, int i),
+    void *arg);
+
+// Runs fn(arg, i) for the count tasks of a dependency graph, each one once
+// its npred[i] predecessors are done; succ[i] lists the nsucc[i] tasks
+// depending on task i.  Tasks made ready by a worker go on its own deque,
+// idle workers steal from the others.
+void pool_graph(struct pool *pool, int count, const int *npred,
+    int *const *succ, const int *nsucc, void (*fn)(void *arg, int i),
+    void *arg);
+
+#endif // _POOL_H
@@ -3,7 +3,21 @@
 
 #include "nk.h"
 
+// counted since wind_init
+struct capture_stats {
+	unsigned long overruns;		// the device buffer overflowed
+	unsigned long short_reads;	// reads got less than the device had
+	unsigned long dropped;		// samples lost on the way to the graph
+};
+
+struct output_stats {
+	unsigned long underruns;	// the output drained with nothing queued
+	unsigned long dropped;		// samples too late for the latency
+};
+
 int wind_init(void);
 int wind_draw(struct nk_context *ctx);
+void wind_capture_stats(struct capture_stats *stats);
+void wind_output_stats(struct output_stats *stats);
 
 #endif // _WIND_H
@@ -0,0 +1,1412 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fft.h"
+#include "pool.h"
+#include "macro.h"
+
+#define TILE 16
+#define BATCH_BYTES (128 * 1024)
+#define TUNE_TIME 0.01		// seconds per timed run
+#define TUNE_RUNS 3
+
+
+typedef float v4sf  __attribute__((vector_size(16), aligned(4)));
+typedef float v8sf  __attribute__((vector_size(32), aligned(4)));
+typedef float v16sf __attribute__((vector_size(64), aligned(4)));
+
+typedef void (*fft_pass)(float *rex, float *imx, const float *wr,
+    const float *wi, int n, int le);
+
+struct fft_kernel {
+	const char *name;
+	int width;
+	fft_pass radix2;
+	fft_pass radix4;
+};
+
+// scratch memory reused by the thread across transforms
+struct scratch {
+	float *buf;
+	size_t size;
+	int busy;
+};
+
+struct batch {
+	struct fft_plan *plan;
+	float *rex, *imx;
+	int count;
+	int group;		// frames per task
+};
+
+struct transpose {
+	const float *sr, *si;	// rows x cols
+	float *dr, *di;		// cols x rows
+	int rows, cols;
+};
+
+struct wisdom {
+	int n;
+	enum fft_algo algo;
+	enum fft_kernel_type kernel;
+};
+
+struct rowfft {
+	struct fft_plan *plan;	// four-step plan being executed
+	struct fft_plan *sub;	// plan of a row
+	float *rex, *imx;
+	int rows;
+	int chunk;		// rows per task
+	int twiddle;		// multiply row j by w^(j*k) after its transform
+};
+
+
+static struct fft_plan *plans;
+static struct wisdom *wisdom;
+
+// guards the plan cache and the wisdom
+static pthread_mutex_t plans_lock = PTHREAD_MUTEX_INITIALIZER;
+static int best_kernel = -1;
+static struct pool *pool;
+
+static struct fft_plan *plan_get(int n);
+
+static __thread struct scratch mixed_scratch;
+static __thread struct scratch bluestein_scratch;
+static __thread struct scratch fourstep_scratch;
+static __thread struct scratch real_scratch;
+
+
+#define CMUL(r, i, xr, xi, wr, wi)					\
+do {									\
+	r = (xr) * (wr) - (xi) * (wi);					\
+	i = (xr) * (wi) + (xi) * (wr);					\
+} while (0)
+
+// one radix-2 stage of half size le, vectorized over the butterflies of a
+// sub DFT; wr/wi point to the le twiddles of the stage
+#define DEFINE_RADIX2(name, vec, isa)					\
+static __attribute__((target(isa))) void				\
+name(float *rex, float *imx, const float *wr, const float *wi, int n,	\
+    int le)								\
+{									\
+	int j, k;							\
+	int w = sizeof (vec) / sizeof (float);				\
+									\
+	for (k = 0; k < n; k += 2*le) {					\
+		for (j = k; j < k + le; j += w) {			\
+			vec ar, ai, tr, ti;				\
+			vec *r0 = (vec*)(rex + j), *i0 = (vec*)(imx + j);	\
+			vec *r1 = (vec*)(rex + j + le);			\
+			vec *i1 = (vec*)(imx + j + le);			\
+									\
+			CMUL(tr, ti, *r1, *i1, *(vec*)(wr + j - k),	\
+			    *(vec*)(wi + j - k));			\
+			ar = *r0;					\
+			ai = *i0;					\
+									\
+			*r1 = ar - tr;					\
+			*i1 = ai - ti;					\
+			*r0 = ar + tr;					\
+			*i0 = ai + ti;					\
+		}							\
+	}								\
+}
+
+// two fused radix-2 stages of half sizes le and 2*le; wr/wi point to the
+// twiddles of the first one, the second stage's follow at wr + le
+#define DEFINE_RADIX4(name, vec, isa)					\
+static __attribute__((target(isa))) void				\
+name(float *rex, float *imx, const float *wr, const float *wi, int n,	\
+    int le)								\
+{									\
+	int j, k;							\
+	int w = sizeof (vec) / sizeof (float);				\
+	const float *w2r = wr + le, *w2i = wi + le;			\
+									\
+	for (k = 0; k < n; k += 4*le) {					\
+		for (j = 0; j < le; j += w) {				\
+			vec ar, ai, br, bi, cr, ci, dr, di, tr, ti;	\
+			vec *r0 = (vec*)(rex + k + j);			\
+			vec *i0 = (vec*)(imx + k + j);			\
+			vec *r1 = (vec*)(rex + k + j + le);		\
+			vec *i1 = (vec*)(imx + k + j + le);		\
+			vec *r2 = (vec*)(rex + k + j + 2*le);		\
+			vec *i2 = (vec*)(imx + k + j + 2*le);		\
+			vec *r3 = (vec*)(rex + k + j + 3*le);		\
+			vec *i3 = (vec*)(imx + k + j + 3*le);		\
+			vec ur = *(vec*)(wr + j), ui = *(vec*)(wi + j);	\
+									\
+			CMUL(tr, ti, *r1, *i1, ur, ui);			\
+			ar = *r0 + tr;					\
+			ai = *i0 + ti;					\
+			br = *r0 - tr;					\
+			bi = *i0 - ti;					\
+									\
+			CMUL(tr, ti, *r3, *i3, ur, ui);			\
+			cr = *r2 + tr;					\
+			ci = *i2 + ti;					\
+			dr = *r2 - tr;					\
+			di = *i2 - ti;					\
+									\
+			CMUL(tr, ti, cr, ci, *(vec*)(w2r + j),		\
+			    *(vec*)(w2i + j));				\
+			*r0 = ar + tr;					\
+			*i0 = ai + ti;					\
+			*r2 = ar - tr;					\
+			*i2 = ai - ti;					\
+									\
+			CMUL(tr, ti, dr, di, *(vec*)(w2r + j + le),	\
+			    *(vec*)(w2i + j + le));			\
+			*r1 = br + tr;					\
+			*i1 = bi + ti;					\
+			*r3 = br - tr;					\
+			*i3 = bi - ti;					\
+		}							\
+	}								\
+}
+
+DEFINE_RADIX2(radix2_sse2, v4sf, "sse2")
+DEFINE_RADIX4(radix4_sse2, v4sf, "sse2")
+DEFINE_RADIX2(radix2_avx2, v8sf, "avx2,fma")
+DEFINE_RADIX4(radix4_avx2, v8sf, "avx2,fma")
+DEFINE_RADIX2(radix2_avx512, v16sf, "avx512f")
+DEFINE_RADIX4(radix4_avx512, v16sf, "avx512f")
+
+static struct fft_kernel kernels[] = {
+	[FFT_KERNEL_SCALAR] = {"scalar", 1,  NULL,          NULL         },
+	[FFT_KERNEL_SSE2]   = {"sse2",   4,  radix2_sse2,   radix4_sse2  },
+	[FFT_KERNEL_AVX2]   = {"avx2",   8,  radix2_avx2,   radix4_avx2  },
+	[FFT_KERNEL_AVX512] = {"avx512", 16, radix2_avx512, radix4_avx512},
+};
+
+
+static int
+kernel_supported(enum fft_kernel_type kernel)
+{
+	__builtin_cpu_init();
+
+	switch (kernel) {
+	case FFT_KERNEL_SCALAR:
+		return 1;
+	case FFT_KERNEL_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case FFT_KERNEL_AVX2:
+		return __builtin_cpu_supports("avx2") &&
+		    __builtin_cpu_supports("fma");
+	case FFT_KERNEL_AVX512:
+		return __builtin_cpu_supports("avx512f");
+	default:
+		return 0;
+	}
+}
+
+static int
+kernel_detect(void)
+{
+	int kernel;
+
+	for (kernel = FFT_KERNELS - 1; kernel > FFT_KERNEL_SCALAR; --kernel)
+		if (kernel_supported(kernel))
+			break;
+
+	return kernel;
+}
+
+static void
+plan_init_radix2(struct fft_plan *plan)
+{
+	int i, j, k;
+	int le;
+	int n = plan->n;
+
+	for (plan->log2n = 0; (1 << plan->log2n) < n; ++plan->log2n)
+		;
+
+	plan->nswaps = 0;
+	plan->swaps = xmalloc(n * sizeof (int));
+
+	for (i = 1, j = n/2; i < n - 1; ++i, j += k) {
+		if (i < j) {
+			plan->swaps[2*plan->nswaps + 0] = i;
+			plan->swaps[2*plan->nswaps + 1] = j;
+			++plan->nswaps;
+		}
+
+		for (k = n/2; k <= j; j -= k, k /= 2)
+			;
+	}
+
+	// stage of half size le keeps its twiddles at [le - 1, 2*le - 1)
+	plan->stwr = xmalloc(n * sizeof (float));
+	plan->stwi = xmalloc(n * sizeof (float));
+
+	for (le = 1; le < n; le *= 2) {
+		for (j = 0; j < le; ++j) {
+			plan->stwr[le - 1 + j] = plan->twr[j * (n/(2*le))];
+			plan->stwi[le - 1 + j] = plan->twi[j * (n/(2*le))];
+		}
+	}
+
+	plan->kernel = best_kernel;
+}
+
+static int
+plan_init_mixed(struct fft_plan *plan)
+{
+	int i;
+	int n = plan->n;
+	static const int radices[] = {4, 2, 3, 5, 7};
+
+	plan->nfactors = 0;
+
+	for (i = 0; i < (int)(sizeof (radices) / sizeof (*radices)) && n > 1; ) {
+		if (n % radices[i] != 0) {
+			++i;
+			continue;
+		}
+
+		n /= radices[i];
+		plan->factors[2*plan->nfactors + 0] = radices[i];
+		plan->factors[2*plan->nfactors + 1] = n;
+		++plan->nfactors;
+	}
+
+	return (n == 1 && plan->nfactors > 0) ? 0 : -1;
+}
+
+static void
+plan_init_bluestein(struct fft_plan *plan)
+{
+	int j, m;
+	int n = plan->n;
+	float *br, *bi;
+
+	for (m = 1; m < 2*n - 1; m *= 2)
+		;
+
+	plan->sub = plan_get(m);
+
+	plan->chr = xmalloc(n * sizeof (float));
+	plan->chi = xmalloc(n * sizeof (float));
+
+	for (j = 0; j < n; ++j) {
+		// k^2 mod 2n keeps the angle exact for large k
+		double a = M_PI * (double)(((long long)j*j) % (2*n)) / n;
+
+		plan->chr[j] =  cos(a);
+		plan->chi[j] = -sin(a);
+	}
+
+	br = plan->bkr = xmalloc(m * sizeof (float));
+	bi = plan->bki = xmalloc(m * sizeof (float));
+	memset(br, 0, m * sizeof (float));
+	memset(bi, 0, m * sizeof (float));
+
+	for (j = 0; j < n; ++j) {
+		br[j] =  plan->chr[j];
+		bi[j] = -plan->chi[j];
+
+		if (j != 0) {
+			br[m - j] = br[j];
+			bi[m - j] = bi[j];
+		}
+	}
+
+	fft_exec(plan->sub, br, bi);
+
+	for (j = 0; j < m; ++j) {
+		br[j] /= m;
+		bi[j] /= m;
+	}
+}
+
+static int
+plan_init_fourstep(struct fft_plan *plan)
+{
+	int j, k;
+	int n1;
+	int n = plan->n;
+
+	for (n1 = sqrt(n); n1 > 1 && n % n1 != 0; --n1)
+		;
+
+	if (n1 <= 1)
+		return -1;
+
+	plan->p1 = plan_get(n1);
+	plan->p2 = plan_get(n / n1);
+
+	plan->fwr = xmalloc(n * sizeof (float));
+	plan->fwi = xmalloc(n * sizeof (float));
+
+	// j*k < n1*n2, no reduction needed
+	for (j = 0; j < plan->p2->n; ++j) {
+		for (k = 0; k < n1; ++k) {
+			plan->fwr[j*n1 + k] = plan->twr[j*k];
+			plan->fwi[j*n1 + k] = plan->twi[j*k];
+		}
+	}
+
+	return 0;
+}
+
+static int
+plan_init_algo(struct fft_plan *plan, enum fft_algo algo)
+{
+	int n = plan->n;
+
+	switch (algo) {
+	case FFT_ALGO_RADIX2:
+		if ((n & (n - 1)) != 0)
+			return -1;
+
+		plan_init_radix2(plan);
+		break;
+
+	case FFT_ALGO_MIXED:
+		if (plan_init_mixed(plan) != 0)
+			return -1;
+		break;
+
+	case FFT_ALGO_BLUESTEIN:
+		plan_init_bluestein(plan);
+		break;
+
+	case FFT_ALGO_FOURSTEP:
+		if (plan_init_fourstep(plan) != 0)
+			return -1;
+		break;
+
+	default:
+		return -1;
+	}
+
+	plan->algo = algo;
+
+	return 0;
+}
+
+// algo FFT_ALGOS picks one from the wisdom or by size
+static int
+plan_init(struct fft_plan *plan, int n, enum fft_algo algo)
+{
+	int i;
+	struct wisdom *w;
+
+	memset(plan, 0, sizeof (struct fft_plan));
+	plan->n = n;
+
+	plan->twr = xmalloc(n * sizeof (float));
+	plan->twi = xmalloc(n * sizeof (float));
+
+	for (i = 0; i < n; ++i) {
+		plan->twr[i] =  cos(2.0*M_PI*i/n);
+		plan->twi[i] = -sin(2.0*M_PI*i/n);
+	}
+
+	plan->kernel = FFT_KERNEL_SCALAR;
+
+	if (algo != FFT_ALGOS)
+		return plan_init_algo(plan, algo);
+
+	w = list_search_by_elem(wisdom, n, n);
+	if (w != NULL && plan_init_algo(plan, w->algo) == 0) {
+		fft_plan_set_kernel(plan, w->kernel);
+		return 0;
+	}
+
+	// split only pays off once the sub transforms run in parallel
+	if (n >= FFT_FOURSTEP_MIN && pool_size(pool) > 1 &&
+	    plan_init_algo(plan, FFT_ALGO_FOURSTEP) == 0)
+		return 0;
+
+	if (plan_init_algo(plan, FFT_ALGO_RADIX2) == 0 ||
+	    plan_init_algo(plan, FFT_ALGO_MIXED) == 0)
+		return 0;
+
+	return plan_init_algo(plan, FFT_ALGO_BLUESTEIN);
+}
+
+// sub plans belong to the cache and stay
+static void
+plan_fini(struct fft_plan *plan)
+{
+	free(plan->twr);
+	free(plan->twi);
+	free(plan->swaps);
+	free(plan->stwr);
+	free(plan->stwi);
+	free(plan->chr);
+	free(plan->chi);
+	free(plan->bkr);
+	free(plan->bki);
+	free(plan->fwr);
+	free(plan->fwi);
+}
+
+void
+fft_set_pool(struct pool *p)
+{
+	pool = p;
+}
+
+// must be called with plans_lock held
+static struct fft_plan*
+plan_get(int n)
+{
+	struct fft_plan *plan;
+
+	plan = list_search_by_elem(plans, n, n);
+	if (plan != NULL)
+		return plan;
+
+	if (best_kernel == -1)
+		best_kernel = kernel_detect();
+
+	plan = list_alloc_at_end(plans);
+	plans = list_get_head(plan);
+
+	plan_init(plan, n, FFT_ALGOS);
+
+	return plan;
+}
+
+struct fft_plan*
+fft_plan_get(int n)
+{
+	struct fft_plan *plan;
+
+	if (n <= 0)
+		return NULL;
+
+	pthread_mutex_lock(&plans_lock);
+
+	plan = plan_get(n);
+
+	pthread_mutex_unlock(&plans_lock);
+
+	return plan;
+}
+
+// The real transforms run on the n/2 plan, made on their first call so
+// complex only plans don't carry it.  Nodes on other workers may share
+// the plan, hence the lock.
+static struct fft_plan*
+plan_half(struct fft_plan *plan)
+{
+	struct fft_plan *half;
+
+	half = __atomic_load_n(&plan->half, __ATOMIC_ACQUIRE);
+	if (half != NULL)
+		return half;
+
+	pthread_mutex_lock(&plans_lock);
+
+	if ((half = plan->half) == NULL) {
+		half = plan_get(plan->n/2);
+		__atomic_store_n(&plan->half, half, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&plans_lock);
+
+	return half;
+}
+
+int
+fft_plan_set_kernel(struct fft_plan *plan, enum fft_kernel_type kernel)
+{
+	if (plan->algo != FFT_ALGO_RADIX2)
+		return -1;
+
+	if (kernel < 0 || kernel >= FFT_KERNELS || !kernel_supported(kernel))
+		return -1;
+
+	plan->kernel = kernel;
+
+	return 0;
+}
+
+const char*
+fft_kernel_name(enum fft_kernel_type kernel)
+{
+	if (kernel < 0 || kernel >= FFT_KERNELS)
+		return NULL;
+
+	return kernels[kernel].name;
+}
+
+// len may span several consecutive frames of plan->n points
+static void
+radix2_scalar(struct fft_plan *plan, float *rex, float *imx, int len, int le)
+{
+	int j, k;
+	int n = len;
+	int step = plan->n/(2*le);
+
+	for (j = 0; j < le; ++j) {					//Each SUB DFT
+		float ur = plan->twr[j*step];
+		float ui = plan->twi[j*step];
+
+		for (k = j; k < n; k += 2*le) {				//Each butterfly
+			int ip = k + le;
+			float tr, ti;
+
+			tr = rex[ip] * ur - imx[ip] * ui;
+			ti = rex[ip] * ui + imx[ip] * ur;
+
+			rex[ip] = rex[k] - tr;
+			imx[ip] = imx[k] - ti;
+
+			rex[k] = rex[k] + tr;
+			imx[k] = imx[k] + ti;
+		}
+	}
+}
+
+// first two stages fused, their twiddles are 1 and -i
+static void
+radix4_first(float *rex, float *imx, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k += 4) {
+		float ar, ai, br, bi, cr, ci, dr, di;
+
+		ar = rex[k] + rex[k + 1];
+		ai = imx[k] + imx[k + 1];
+		br = rex[k] - rex[k + 1];
+		bi = imx[k] - imx[k + 1];
+		cr = rex[k + 2] + rex[k + 3];
+		ci = imx[k + 2] + imx[k + 3];
+		dr = rex[k + 2] - rex[k + 3];
+		di = imx[k + 2] - imx[k + 3];
+
+		rex[k]     = ar + cr;
+		imx[k]     = ai + ci;
+		rex[k + 2] = ar - cr;
+		imx[k + 2] = ai - ci;
+		rex[k + 1] = br + di;
+		imx[k + 1] = bi - dr;
+		rex[k + 3] = br - di;
+		imx[k + 3] = bi + dr;
+	}
+}
+
+// the frames are contiguous and every pass works on blocks dividing n, so a
+// pass over the whole batch is one pass over count*n points
+static void
+exec_radix2(struct fft_plan *plan, float *rex, float *imx, int count)
+{
+	int i, f;
+	int n = plan->n;
+	int len = n * count;
+	int le;
+	struct fft_kernel *kernel = &kernels[plan->kernel];
+
+	for (f = 0; f < len; f += n) {
+		float *r = rex + f, *im = imx + f;
+
+		for (i = 0; i < plan->nswaps; ++i) {
+			SWAP(r[plan->swaps[2*i]], r[plan->swaps[2*i + 1]]);
+			SWAP(im[plan->swaps[2*i]], im[plan->swaps[2*i + 1]]);
+		}
+	}
+
+	le = 1;
+	if (kernel->radix2 != NULL && n >= 4) {
+		radix4_first(rex, imx, len);
+		le = 4;
+	}
+
+	// stages narrower than a vector stay scalar
+	for (; le < n && (le < kernel->width || kernel->radix2 == NULL);
+	    le *= 2)
+		radix2_scalar(plan, rex, imx, len, le);
+
+	for (; 4*le <= n; le *= 4)
+		kernel->radix4(rex, imx, plan->stwr + le - 1,
+		    plan->stwi + le - 1, len, le);
+
+	if (le < n)
+		kernel->radix2(rex, imx, plan->stwr + le - 1,
+		    plan->stwi + le - 1, len, le);
+}
+
+static float*
+scratch_get(struct scratch *s, size_t size)
+{
+	// nested use on the same thread falls back to the heap
+	if (s->busy)
+		return xmalloc(size * sizeof (float));
+
+	if (s->size < size) {
+		s->buf = xrealloc(s->buf, size * sizeof (float));
+		s->size = size;
+	}
+
+	s->busy = 1;
+
+	return s->buf;
+}
+
+static void
+scratch_put(struct scratch *s, float *buf)
+{
+	if (buf == s->buf)
+		s->busy = 0;
+	else
+		free(buf);
+}
+
+static void
+bfly2(float *or, float *oi, struct fft_plan *plan, int fstride, int m)
+{
+	int k;
+
+	for (k = 0; k < m; ++k) {
+		float tr, ti;
+
+		CMUL(tr, ti, or[m + k], oi[m + k], plan->twr[k*fstride],
+		    plan->twi[k*fstride]);
+
+		or[m + k] = or[k] - tr;
+		oi[m + k] = oi[k] - ti;
+		or[k] += tr;
+		oi[k] += ti;
+	}
+}
+
+static void
+bfly4(float *or, float *oi, struct fft_plan *plan, int fstride, int m)
+{
+	int k;
+
+	for (k = 0; k < m; ++k) {
+		float r0, i0, r1, i1, r2, i2, r3, i3, r4, i4, r5, i5;
+
+		CMUL(r0, i0, or[k + m], oi[k + m], plan->twr[k*fstride],
+		    plan->twi[k*fstride]);
+		CMUL(r1, i1, or[k + 2*m], oi[k + 2*m], plan->twr[2*k*fstride],
+		    plan->twi[2*k*fstride]);
+		CMUL(r2, i2, or[k + 3*m], oi[k + 3*m], plan->twr[3*k*fstride],
+		    plan->twi[3*k*fstride]);
+
+		r5 = or[k] - r1;
+		i5 = oi[k] - i1;
+		r3 = r0 + r2;
+		i3 = i0 + i2;
+		r4 = r0 - r2;
+		i4 = i0 - i2;
+
+		or[k + 2*m] = or[k] + r1 - r3;
+		oi[k + 2*m] = oi[k] + i1 - i3;
+		or[k] += r1 + r3;
+		oi[k] += i1 + i3;
+
+		or[k + m]   = r5 + i4;
+		oi[k + m]   = i5 - r4;
+		or[k + 3*m] = r5 - i4;
+		oi[k + 3*m] = i5 + r4;
+	}
+}
+
+// radix 3, 5 and 7 as a direct DFT of each p point group
+static void
+bfly_generic(float *or, float *oi, struct fft_plan *plan, int fstride,
+    int m, int p)
+{
+	int k, q, q1;
+	int n = plan->n;
+	float sr[7], si[7];
+
+	for (k = 0; k < m; ++k) {
+		for (q = 0; q < p; ++q) {
+			int tw = q*k*fstride;
+
+			CMUL(sr[q], si[q], or[k + q*m], oi[k + q*m],
+			    plan->twr[tw], plan->twi[tw]);
+		}
+
+		for (q1 = 0; q1 < p; ++q1) {
+			int tw = 0;
+			float accr = sr[0], acci = si[0];
+
+			for (q = 1; q < p; ++q) {
+				float tr, ti;
+
+				tw += q1*m*fstride;
+				if (tw >= n)
+					tw -= n;
+
+				CMUL(tr, ti, sr[q], si[q], plan->twr[tw],
+				    plan->twi[tw]);
+				accr += tr;
+				acci += ti;
+			}
+
+			or[k + q1*m] = accr;
+			oi[k + q1*m] = acci;
+		}
+	}
+}
+
+// decimation in time: transform each of the p interleaved subsequences
+// into its own block of the output, then combine the blocks
+static void
+mixed_work(struct fft_plan *plan, float *or, float *oi, const float *ir,
+    const float *ii, int fstride, const int *factors)
+{
+	int q;
+	int p = factors[0];
+	int m = factors[1];
+
+	if (m == 1) {
+		for (q = 0; q < p; ++q) {
+			or[q] = ir[q*fstride];
+			oi[q] = ii[q*fstride];
+		}
+	}
+	else {
+		for (q = 0; q < p; ++q)
+			mixed_work(plan, or + q*m, oi + q*m, ir + q*fstride,
+			    ii + q*fstride, fstride*p, factors + 2);
+	}
+
+	if (p == 2)
+		bfly2(or, oi, plan, fstride, m);
+	else if (p == 4)
+		bfly4(or, oi, plan, fstride, m);
+	else
+		bfly_generic(or, oi, plan, fstride, m, p);
+}
+
+static void
+exec_mixed(struct fft_plan *plan, float *rex, float *imx)
+{
+	int n = plan->n;
+	float *ir, *ii;
+
+	ir = scratch_get(&mixed_scratch, 2 * n);
+	ii = ir + n;
+
+	memcpy(ir, rex, n * sizeof (float));
+	memcpy(ii, imx, n * sizeof (float));
+
+	mixed_work(plan, rex, imx, ir, ii, 1, plan->factors);
+
+	scratch_put(&mixed_scratch, ir);
+}
+
+static void
+exec_bluestein(struct fft_plan *plan, float *rex, float *imx)
+{
+	int k;
+	int n = plan->n;
+	int m = plan->sub->n;
+	float *ar, *ai;
+
+	ar = scratch_get(&bluestein_scratch, 2 * m);
+	ai = ar + m;
+
+	for (k = 0; k < n; ++k)
+		CMUL(ar[k], ai[k], rex[k], imx[k], plan->chr[k], plan->chi[k]);
+
+	memset(ar + n, 0, (m - n) * sizeof (float));
+	memset(ai + n, 0, (m - n) * sizeof (float));
+
+	fft_exec(plan->sub, ar, ai);
+
+	for (k = 0; k < m; ++k) {
+		float tr = ar[k];
+
+		ar[k] = tr * plan->bkr[k] - ai[k] * plan->bki[k];
+		ai[k] = tr * plan->bki[k] + ai[k] * plan->bkr[k];
+	}
+
+	// inverse transform by swapping real and imaginary parts
+	fft_exec(plan->sub, ai, ar);
+
+	for (k = 0; k < n; ++k)
+		CMUL(rex[k], imx[k], ar[k], ai[k], plan->chr[k], plan->chi[k]);
+
+	scratch_put(&bluestein_scratch, ar);
+}
+
+// transposes a band of TILE source rows, tile by tile
+static void
+transpose_task(void *arg, int band)
+{
+	int i, j, r, c;
+	struct transpose *t = arg;
+	int r0 = band * TILE;
+	int r1 = MIN(r0 + TILE, t->rows);
+
+	for (c = 0; c < t->cols; c += TILE) {
+		int c1 = MIN(c + TILE, t->cols);
+
+		for (r = r0; r < r1; ++r) {
+			for (j = c; j < c1; ++j) {
+				i = j * t->rows + r;
+
+				t->dr[i] = t->sr[r * t->cols + j];
+				t->di[i] = t->si[r * t->cols + j];
+			}
+		}
+	}
+}
+
+static void
+transpose(const float *sr, const float *si, float *dr, float *di, int rows,
+    int cols)
+{
+	struct transpose t = {sr, si, dr, di, rows, cols};
+
+	pool_for(pool, (rows + TILE - 1) / TILE, transpose_task, &t);
+}
+
+static void
+rowfft_task(void *arg, int chunk)
+{
+	int j, k;
+	struct rowfft *t = arg;
+	int len = t->sub->n;
+	int end = MIN((chunk + 1) * t->chunk, t->rows);
+
+	for (j = chunk * t->chunk; j < end; ++j) {
+		float *rex = t->rex + j*len;
+		float *imx = t->imx + j*len;
+		const float *wr = t->plan->fwr + j*len;
+		const float *wi = t->plan->fwi + j*len;
+
+		fft_exec(t->sub, rex, imx);
+
+		if (!t->twiddle)
+			continue;
+
+		for (k = 1; k < len; ++k) {
+			float tr = rex[k];
+
+			rex[k] = tr * wr[k] - imx[k] * wi[k];
+			imx[k] = tr * wi[k] + imx[k] * wr[k];
+		}
+	}
+}
+
+static void
+rowfft(struct fft_plan *plan, struct fft_plan *sub, float *rex, float *imx,
+    int rows, int twiddle)
+{
+	struct rowfft t = {plan, sub, rex, imx, rows, 0, twiddle};
+	int tasks = MIN(rows, 4 * pool_size(pool));
+
+	t.chunk = (rows + tasks - 1) / tasks;
+
+	pool_for(pool, (rows + t.chunk - 1) / t.chunk, rowfft_task, &t);
+}
+
+// x[n2*j1 + j2] -> X[k1 + n1*k2]: n2 transforms of length n1 over the
+// columns, a twiddle w^(j2*k1), then n1 transforms of length n2
+static void
+exec_fourstep(struct fft_plan *plan, float *rex, float *imx)
+{
+	int n = plan->n;
+	int n1 = plan->p1->n;
+	int n2 = plan->p2->n;
+	float *ar, *ai;
+
+	ar = scratch_get(&fourstep_scratch, 2 * n);
+	ai = ar + n;
+
+	transpose(rex, imx, ar, ai, n1, n2);
+	rowfft(plan, plan->p1, ar, ai, n2, 1);
+
+	transpose(ar, ai, rex, imx, n2, n1);
+	rowfft(plan, plan->p2, rex, imx, n1, 0);
+
+	transpose(rex, imx, ar, ai, n1, n2);
+	memcpy(rex, ar, n * sizeof (float));
+	memcpy(imx, ai, n * sizeof (float));
+
+	scratch_put(&fourstep_scratch, ar);
+}
+
+static void
+exec_group(struct fft_plan *plan, float *rex, float *imx, int count)
+{
+	int f;
+	int n = plan->n;
+
+	if (plan->algo == FFT_ALGO_RADIX2) {
+		exec_radix2(plan, rex, imx, count);
+		return;
+	}
+
+	for (f = 0; f < count; ++f) {
+		switch (plan->algo) {
+		case FFT_ALGO_MIXED:
+			exec_mixed(plan, rex + f*n, imx + f*n);
+			break;
+
+		case FFT_ALGO_BLUESTEIN:
+			exec_bluestein(plan, rex + f*n, imx + f*n);
+			break;
+
+		case FFT_ALGO_FOURSTEP:
+			exec_fourstep(plan, rex + f*n, imx + f*n);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+static void
+batch_task(void *arg, int group)
+{
+	struct batch *b = arg;
+	int n = b->plan->n;
+	int first = group * b->group;
+
+	exec_group(b->plan, b->rex + first*n, b->imx + first*n,
+	    MIN(b->group, b->count - first));
+}
+
+void
+fft_exec_batch(struct fft_plan *plan, float *rex, float *imx, int count)
+{
+	struct batch b = {plan, rex, imx, count, 0};
+	int groups;
+
+	if (count <= 0)
+		return;
+
+	// frames are grouped to stay in cache while a group goes through
+	// all of its passes; groups are spread over the pool
+	b.group = MAX(1, BATCH_BYTES / (2 * plan->n * (int)sizeof (float)));
+	groups = (count + b.group - 1) / b.group;
+
+	if (groups == 1 || plan->algo == FFT_ALGO_FOURSTEP)
+		exec_group(plan, rex, imx, count);
+	else
+		pool_for(pool, groups, batch_task, &b);
+}
+
+void
+fft_exec(struct fft_plan *plan, float *rex, float *imx)
+{
+	fft_exec_batch(plan, rex, imx, 1);
+}
+
+// splits the transform z of the packed even/odd sequence and recombines it
+// into bin k at o[k*stride]; z may be the output itself with stride 1
+static void
+real_split(struct fft_plan *plan, const float *zr, const float *zi, float *or,
+    float *oi, int stride)
+{
+	int k;
+	int m = plan->n/2;
+	float er, ei, dr, di, tr, ti;
+
+	for (k = 1; k <= m/2; ++k) {
+		float wr = plan->twr[k];
+		float wi = plan->twi[k];
+
+		er = (zr[k] + zr[m - k]) / 2;
+		ei = (zi[k] - zi[m - k]) / 2;
+		dr = (zi[k] + zi[m - k]) / 2;
+		di = (zr[m - k] - zr[k]) / 2;
+
+		tr = wr * dr - wi * di;
+		ti = wr * di + wi * dr;
+
+		or[k*stride] = er + tr;
+		oi[k*stride] = ei + ti;
+		or[(m - k)*stride] =   er - tr;
+		oi[(m - k)*stride] = -(ei - ti);
+	}
+
+	tr = zr[0];
+	ti = zi[0];
+	or[0] = tr + ti;
+	oi[0] = tr - ti;
+}
+
+// rebuilds the transform z of the packed even/odd sequence from bin k at
+// x[k*stride]; z may be the input itself with stride 1
+static void
+real_merge(struct fft_plan *plan, const float *xr, const float *xi, int stride,
+    float *zr, float *zi)
+{
+	int k;
+	int m = plan->n/2;
+	float er, ei, dr, di, or, oi, tr, ti;
+
+	for (k = 1; k <= m/2; ++k) {
+		float wr = plan->twr[k];
+		float wi = plan->twi[k];
+
+		er = xr[k*stride] + xr[(m - k)*stride];
+		ei = xi[k*stride] - xi[(m - k)*stride];
+		dr = xr[k*stride] - xr[(m - k)*stride];
+		di = xi[k*stride] + xi[(m - k)*stride];
+
+		// i * conj(w) * (dr + i*di)
+		or = -(wr * di - wi * dr);
+		oi =   wr * dr + wi * di;
+
+		zr[k] = er + or;
+		zi[k] = ei + oi;
+		zr[m - k] =   er - or;
+		zi[m - k] = -(ei - oi);
+	}
+
+	tr = xr[0];
+	ti = xi[0];
+	zr[0] = tr + ti;
+	zi[0] = tr - ti;
+}
+
+static void
+real_pack(const float *in, float *zr, float *zi, int m)
+{
+	int k;
+
+	for (k = 0; k < m; ++k) {
+		zr[k] = in[2*k];
+		zi[k] = in[2*k + 1];
+	}
+}
+
+static void
+real_unpack(const float *zr, const float *zi, float *out, int m)
+{
+	int k;
+
+	for (k = 0; k < m; ++k) {
+		out[2*k] = zr[k];
+		out[2*k + 1] = zi[k];
+	}
+}
+
+void
+fft_exec_real_batch(struct fft_plan *plan, const float *in, float *rex,
+    float *imx, int count)
+{
+	int k;
+	int m = plan->n/2;
+
+	real_pack(in, rex, imx, m * count);
+	fft_exec_batch(plan_half(plan), rex, imx, count);
+
+	for (k = 0; k < count; ++k)
+		real_split(plan, rex + k*m, imx + k*m, rex + k*m, imx + k*m, 1);
+}
+
+void
+fft_exec_real_inv_batch(struct fft_plan *plan, float *rex, float *imx,
+    float *out, int count)
+{
+	int k;
+	int m = plan->n/2;
+
+	for (k = 0; k < count; ++k)
+		real_merge(plan, rex + k*m, imx + k*m, 1, rex + k*m, imx + k*m);
+
+	// inverse transform by swapping real and imaginary parts
+	fft_exec_batch(plan_half(plan), imx, rex, count);
+
+	real_unpack(rex, imx, out, m * count);
+}
+
+void
+fft_exec_real(struct fft_plan *plan, const float *in, float *rex, float *imx)
+{
+	fft_exec_real_batch(plan, in, rex, imx, 1);
+}
+
+void
+fft_exec_real_inv(struct fft_plan *plan, float *rex, float *imx, float *out)
+{
+	fft_exec_real_inv_batch(plan, rex, imx, out, 1);
+}
+
+void
+fft_exec_real_c(struct fft_plan *plan, const float *in, float *out)
+{
+	int m = plan->n/2;
+	float *zr, *zi;
+
+	zr = scratch_get(&real_scratch, 2 * m);
+	zi = zr + m;
+
+	real_pack(in, zr, zi, m);
+	fft_exec(plan_half(plan), zr, zi);
+	real_split(plan, zr, zi, out, out + 1, 2);
+
+	scratch_put(&real_scratch, zr);
+}
+
+void
+fft_exec_real_inv_c(struct fft_plan *plan, const float *in, float *out)
+{
+	int m = plan->n/2;
+	float *zr, *zi;
+
+	zr = scratch_get(&real_scratch, 2 * m);
+	zi = zr + m;
+
+	real_merge(plan, in, in + 1, 2, zr, zi);
+	fft_exec(plan_half(plan), zi, zr);
+	real_unpack(zr, zi, out, m);
+
+	scratch_put(&real_scratch, zr);
+}
+
+static const char *algo_names[] = {
+	[FFT_ALGO_RADIX2]    = "radix2",
+	[FFT_ALGO_MIXED]     = "mixed",
+	[FFT_ALGO_BLUESTEIN] = "bluestein",
+	[FFT_ALGO_FOURSTEP]  = "fourstep",
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// best of a few runs, each one repeated long enough to be timed
+static double
+plan_time(struct fft_plan *plan, float *rex, float *imx)
+{
+	int i, run;
+	int reps = 1;
+	double t, best = HUGE_VAL;
+
+	for (run = 0; run < TUNE_RUNS; ) {
+		t = now();
+		for (i = 0; i < reps; ++i)
+			fft_exec(plan, rex, imx);
+		t = now() - t;
+
+		if (t < TUNE_TIME) {
+			reps *= 2;
+			continue;
+		}
+
+		best = MIN(best, t / reps);
+		++run;
+	}
+
+	return best;
+}
+
+static void
+wisdom_set(int n, enum fft_algo algo, enum fft_kernel_type kernel)
+{
+	struct wisdom *w;
+
+	if ((w = list_search_by_elem(wisdom, n, n)) == NULL) {
+		w = list_alloc_at_end(wisdom);
+		wisdom = list_get_head(w);
+		w->n = n;
+	}
+
+	w->algo = algo;
+	w->kernel = kernel;
+}
+
+// Times the candidates on private plans, only building them and recording
+// the winner take the lock; the cached plans keep running meanwhile
+static void
+plan_tune(int n)
+{
+	int algo, kernel, ok;
+	double t, best = HUGE_VAL;
+	enum fft_algo balgo = FFT_ALGOS;
+	enum fft_kernel_type bkernel = FFT_KERNEL_SCALAR;
+	struct fft_plan *cand;
+	float *rex, *imx;
+
+	// zeros time the same as any data and never overflow
+	rex = xmalloc(2 * n * sizeof (float));
+	imx = rex + n;
+	memset(rex, 0, 2 * n * sizeof (float));
+
+	cand = xmalloc(sizeof (struct fft_plan));
+
+	for (algo = 0; algo < FFT_ALGOS; ++algo) {
+		// sub plans come from the cache
+		pthread_mutex_lock(&plans_lock);
+		ok = (plan_init(cand, n, algo) == 0);
+		pthread_mutex_unlock(&plans_lock);
+
+		if (!ok) {
+			plan_fini(cand);
+			continue;
+		}
+
+		// only radix-2 has kernels to choose from
+		for (kernel = 0; kernel < FFT_KERNELS; ++kernel) {
+			if (algo == FFT_ALGO_RADIX2 ?
+			    fft_plan_set_kernel(cand, kernel) != 0 :
+			    kernel != FFT_KERNEL_SCALAR)
+				continue;
+
+			t = plan_time(cand, rex, imx);
+			if (t < best) {
+				best = t;
+				balgo = algo;
+				bkernel = cand->kernel;
+			}
+		}
+
+		plan_fini(cand);
+	}
+
+	free(cand);
+	free(rex);
+
+	if (balgo == FFT_ALGOS)
+		return;
+
+	pthread_mutex_lock(&plans_lock);
+	wisdom_set(n, balgo, bkernel);
+	pthread_mutex_unlock(&plans_lock);
+}
+
+static int
+size_cmp(const void *a, const void *b)
+{
+	return *(const int*)a - *(const int*)b;
+}
+
+void
+fft_autotune(void)
+{
+	int i;
+	int count = 0;
+	int *sizes;
+	struct fft_plan *plan;
+
+	pthread_mutex_lock(&plans_lock);
+
+	list_foreach (plans, plan)
+		++count;
+
+	sizes = xmalloc(MAX(count, 1) * sizeof (int));
+
+	i = 0;
+	list_foreach (plans, plan)
+		sizes[i++] = plan->n;
+
+	pthread_mutex_unlock(&plans_lock);
+
+	qsort(sizes, count, sizeof (int), size_cmp);
+
+	for (i = 0; i < count; ++i)
+		plan_tune(sizes[i]);
+
+	free(sizes);
+}
+
+// Rebuilt in place, other plans and the nodes point to them; the half plan
+// is a cached one and stays.  Plans the rebuilt ones add to the cache are
+// built from the wisdom already.
+void
+fft_replan(void)
+{
+	int i;
+	int count = 0;
+	struct fft_plan *plan, *half;
+	struct fft_plan **cached;
+
+	pthread_mutex_lock(&plans_lock);
+
+	list_foreach (plans, plan)
+		++count;
+
+	cached = xmalloc(MAX(count, 1) * sizeof (struct fft_plan*));
+
+	i = 0;
+	list_foreach (plans, plan)
+		cached[i++] = plan;
+
+	for (i = 0; i < count; ++i) {
+		plan = cached[i];
+
+		half = plan->half;
+		plan_fini(plan);
+		plan_init(plan, plan->n, FFT_ALGOS);
+		plan->half = half;
+	}
+
+	pthread_mutex_unlock(&plans_lock);
+
+	free(cached);
+}
+
+int
+fft_wisdom_load(const char *path)
+{
+	int n, algo, kernel;
+	char aname[16], kname[16];
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return -1;
+
+	pthread_mutex_lock(&plans_lock);
+
+	while (fscanf(fp, "%d %15s %15s", &n, aname, kname) == 3) {
+		for (algo = 0; algo < FFT_ALGOS; ++algo)
+			if (strcmp(aname, algo_names[algo]) == 0)
+				break;
+
+		for (kernel = 0; kernel < FFT_KERNELS; ++kernel)
+			if (strcmp(kname, kernels[kernel].name) == 0)
+				break;
+
+		if (n <= 0 || algo == FFT_ALGOS || kernel == FFT_KERNELS)
+			continue;
+
+		wisdom_set(n, algo, kernel);
+	}
+
+	pthread_mutex_unlock(&plans_lock);
+
+	fclose(fp);
+
+	return 0;
+}
+
+int
+fft_wisdom_save(const char *path)
+{
+	struct wisdom *w;
+	FILE *fp;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		return -1;
+
+	pthread_mutex_lock(&plans_lock);
+
+	list_foreach (wisdom, w)
+		fprintf(fp, "%d %s %s\n", w->n, algo_names[w->algo],
+		    kernels[w->kernel].name);
+
+	pthread_mutex_unlock(&plans_lock);
+
+	return (fclose(fp) == 0) ? 0 : -1;
+}
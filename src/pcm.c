@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pcm.h"
+#include "macro.h"
+
+
+typedef float v4sf __attribute__((vector_size(16), aligned(4)));
+typedef float v8sf __attribute__((vector_size(32), aligned(4)));
+typedef int v4si __attribute__((vector_size(16)));
+typedef int v8si __attribute__((vector_size(32)));
+typedef int16_t v4hi __attribute__((vector_size(8), aligned(2)));
+typedef int16_t v8hi __attribute__((vector_size(16), aligned(2)));
+
+// frames is a multiple of the width
+typedef void (*pcm_fn)(const int16_t *src, int chnls, int frames,
+    float **dst);
+
+struct pcm_kernel {
+	int width;
+	pcm_fn fn;
+};
+
+
+static int best_kernel = -1;
+
+
+// A block of width frames converts to chnls vectors.  Each stage unzips
+// the pairs of vectors into their even and odd lanes: the even lanes of
+// all the pairs hold the even channels, interleaved again, and go to the
+// first half.  After log2(chnls) stages vector c holds channel c.
+#define DEFINE_PCM(name, vec, ivec, hvec, isa)				\
+static __attribute__((target(isa))) void				\
+name(const int16_t *src, int chnls, int frames, float **dst)		\
+{									\
+	int i, c, k, s;							\
+	int w = sizeof (vec) / sizeof (float);				\
+	int half = chnls / 2;						\
+	vec v[PCM_CHNLS_MAX], t[PCM_CHNLS_MAX];				\
+	ivec ev, od;							\
+									\
+	for (i = 0; i < w; ++i) {					\
+		ev[i] = 2*i;						\
+		od[i] = 2*i + 1;					\
+	}								\
+									\
+	for (i = 0; i < frames; i += w) {				\
+		for (c = 0; c < chnls; ++c)				\
+			v[c] = __builtin_convertvector(			\
+			    *(hvec*)(src + (i*chnls + c*w)), vec) /	\
+			    INT16_MAX;					\
+									\
+		for (s = 1; s < chnls; s *= 2) {			\
+			for (k = 0; k < half; ++k) {			\
+				t[k] = __builtin_shuffle(v[2*k],	\
+				    v[2*k + 1], ev);			\
+				t[k + half] = __builtin_shuffle(v[2*k],	\
+				    v[2*k + 1], od);			\
+			}						\
+									\
+			memcpy(v, t, chnls * sizeof (vec));		\
+		}							\
+									\
+		for (c = 0; c < chnls; ++c)				\
+			*(vec*)(dst[c] + i) = v[c];			\
+	}								\
+}
+
+DEFINE_PCM(pcm_sse2, v4sf, v4si, v4hi, "sse2")
+DEFINE_PCM(pcm_avx2, v8sf, v8si, v8hi, "avx2")
+
+static struct pcm_kernel kernels[] = {
+	{4, pcm_sse2},
+	{8, pcm_avx2},
+};
+
+
+static int
+kernel_detect(void)
+{
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return 1;
+
+	return 0;
+}
+
+void
+pcm_deinterleave(const int16_t *src, int chnls, int frames, float **dst)
+{
+	int i, c;
+	int body = 0;
+
+	if (best_kernel == -1)
+		best_kernel = kernel_detect();
+
+	// other channel counts and the tail go one sample at a time
+	if ((chnls & (chnls - 1)) == 0 && chnls <= PCM_CHNLS_MAX) {
+		body = frames - frames % kernels[best_kernel].width;
+		kernels[best_kernel].fn(src, chnls, body, dst);
+	}
+
+	for (i = body; i < frames; ++i)
+		for (c = 0; c < chnls; ++c)
+			dst[c][i] = (float)src[i*chnls + c] / INT16_MAX;
+}
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <immintrin.h>
+
+#include "polar.h"
+#include "macro.h"
+
+#define POLAR_MAXWIDTH 16
+#define POWER_MIN 1e-20f	// 10*log10(POWER_MIN) == POLAR_DB_MIN
+
+
+typedef float v4sf  __attribute__((vector_size(16), aligned(4)));
+typedef float v8sf  __attribute__((vector_size(32), aligned(4)));
+typedef float v16sf __attribute__((vector_size(64), aligned(4)));
+typedef int v4si  __attribute__((vector_size(16)));
+typedef int v8si  __attribute__((vector_size(32)));
+typedef int v16si __attribute__((vector_size(64)));
+
+// im == NULL means re holds interleaved pairs; n is a multiple of the width
+typedef void (*polar_fn)(enum polar_mode mode, int fast, const float *re,
+    const float *im, float *out, int n);
+
+struct polar_kernel {
+	int width;
+	polar_fn fn;
+};
+
+
+static int best_kernel = -1;
+
+static const char *mode_names[] = {
+	[POLAR_MAG]   = "|X|",
+	[POLAR_POWER] = "|X|^2",
+	[POLAR_DB]    = "dB",
+	[POLAR_PHASE] = "Phase",
+};
+
+
+#define SQRT_SSE2(x)     ((v4sf)_mm_sqrt_ps((__m128)(x)))
+#define RSQRT_SSE2(x)    ((v4sf)_mm_rsqrt_ps((__m128)(x)))
+#define RCP_SSE2(x)      ((v4sf)_mm_rcp_ps((__m128)(x)))
+#define SQRT_AVX2(x)     ((v8sf)_mm256_sqrt_ps((__m256)(x)))
+#define RSQRT_AVX2(x)    ((v8sf)_mm256_rsqrt_ps((__m256)(x)))
+#define RCP_AVX2(x)      ((v8sf)_mm256_rcp_ps((__m256)(x)))
+#define SQRT_AVX512(x)   ((v16sf)_mm512_sqrt_ps((__m512)(x)))
+#define RSQRT_AVX512(x)  ((v16sf)_mm512_rsqrt14_ps((__m512)(x)))
+#define RCP_AVX512(x)    ((v16sf)_mm512_rcp14_ps((__m512)(x)))
+
+// m ? a : b, lane by lane
+#define BLEND(vec, ivec, m, a, b)					\
+	((vec)(((ivec)(a) & (m)) | ((ivec)(b) & ~(m))))
+
+// log2 splits off the exponent: the precise path takes ln of the mantissa
+// as 2*atanh((m-1)/(m+1)) on [sqrt(1/2), sqrt(2)), the fast one a cubic
+// fit on [1, 2).  atan2 folds the angle into atan(a), 0 <= a <= 1; the
+// precise path reduces a below tan(pi/8) for the cephes polynomial.
+#define DEFINE_POLAR(name, vec, ivec, isa, SQRT, RSQRT, RCP)		\
+static __attribute__((target(isa))) void				\
+name(enum polar_mode mode, int fast, const float *re, const float *im,	\
+    float *out, int n)							\
+{									\
+	int i;								\
+	int w = sizeof (vec) / sizeof (float);				\
+	vec zero = {0};							\
+	ivec ev, od;							\
+									\
+	for (i = 0; i < w; ++i) {					\
+		ev[i] = 2*i;						\
+		od[i] = 2*i + 1;					\
+	}								\
+									\
+	for (i = 0; i < n; i += w) {					\
+		vec x, y, p, r, m, a, t, t2;				\
+		ivec bits, e, k;					\
+									\
+		if (im != NULL) {					\
+			x = *(vec*)(re + i);				\
+			y = *(vec*)(im + i);				\
+		}							\
+		else {							\
+			vec lo = *(vec*)(re + 2*i);			\
+			vec hi = *(vec*)(re + 2*i + w);			\
+									\
+			x = __builtin_shuffle(lo, hi, ev);		\
+			y = __builtin_shuffle(lo, hi, od);		\
+		}							\
+									\
+		p = x*x + y*y;						\
+									\
+		switch (mode) {						\
+		case POLAR_MAG:						\
+			if (fast) {					\
+				k = p < FLT_MIN;			\
+				r = p * RSQRT(BLEND(vec, ivec, k,	\
+				    zero + FLT_MIN, p));		\
+			}						\
+			else						\
+				r = SQRT(p);				\
+			break;						\
+									\
+		case POLAR_POWER:					\
+			r = p;						\
+			break;						\
+									\
+		case POLAR_DB:						\
+			k = p < POWER_MIN;				\
+			p = BLEND(vec, ivec, k, zero + POWER_MIN, p);	\
+									\
+			bits = (ivec)p;					\
+			e = (bits >> 23) - 127;				\
+			m = (vec)((bits & 0x7fffff) | 0x3f800000);	\
+									\
+			if (fast)					\
+				r = -2.15362028f + m*(3.04788323f +	\
+				    m*(-1.05187439f + m*0.158248561f));	\
+			else {						\
+				k = m > (float)M_SQRT2;			\
+				m = BLEND(vec, ivec, k, m*0.5f, m);	\
+				e -= k;					\
+									\
+				t = (m - 1.0f) / (m + 1.0f);		\
+				t2 = t*t;				\
+				r = 2.0f*t*(1.0f + t2*(1.0f/3 +		\
+				    t2*(1.0f/5 + t2*(1.0f/7 +		\
+				    t2*(1.0f/9)))));			\
+				r *= (float)M_LOG2E;			\
+			}						\
+									\
+			r += __builtin_convertvector(e, vec);		\
+			r *= 3.01029995664f;	/* 10*log10(2) */	\
+			break;						\
+									\
+		case POLAR_PHASE:					\
+		default:						\
+			m = (vec)((ivec)x & INT_MAX);			\
+			a = (vec)((ivec)y & INT_MAX);			\
+			k = a > m;					\
+			t = BLEND(vec, ivec, k, a, m);			\
+			a = BLEND(vec, ivec, k, m, a);			\
+			t = BLEND(vec, ivec, t < FLT_MIN,		\
+			    zero + FLT_MIN, t);				\
+									\
+			if (fast) {					\
+				a *= RCP(t);				\
+				r = (float)M_PI_4*a - a*(a - 1.0f)*	\
+				    (0.2447f + 0.0663f*a);		\
+			}						\
+			else {						\
+				a /= t;					\
+				bits = a > 0.414213562f;		\
+				t = (vec)(bits &			\
+				    (ivec)(zero + (float)M_PI_4));	\
+				a = BLEND(vec, ivec, bits,		\
+				    (a - 1.0f) / (a + 1.0f), a);	\
+									\
+				t2 = a*a;				\
+				r = (((8.05374449538e-2f*t2 -		\
+				    1.38776856032e-1f)*t2 +		\
+				    1.99777106478e-1f)*t2 -		\
+				    3.33329491539e-1f)*t2*a + a + t;	\
+			}						\
+									\
+			/* quadrant from the swap and the signs */	\
+			r = BLEND(vec, ivec, k, (float)M_PI_2 - r, r);	\
+			r = BLEND(vec, ivec, (ivec)x < 0,		\
+			    (float)M_PI - r, r);			\
+			r = (vec)((ivec)r | ((ivec)y & INT_MIN));	\
+			break;						\
+		}							\
+									\
+		*(vec*)(out + i) = r;					\
+	}								\
+}
+
+DEFINE_POLAR(polar_sse2, v4sf, v4si, "sse2", SQRT_SSE2, RSQRT_SSE2, RCP_SSE2)
+DEFINE_POLAR(polar_avx2, v8sf, v8si, "avx2,fma", SQRT_AVX2, RSQRT_AVX2,
+    RCP_AVX2)
+DEFINE_POLAR(polar_avx512, v16sf, v16si, "avx512f", SQRT_AVX512,
+    RSQRT_AVX512, RCP_AVX512)
+
+static struct polar_kernel kernels[] = {
+	{4,  polar_sse2  },
+	{8,  polar_avx2  },
+	{16, polar_avx512},
+};
+
+
+static int
+kernel_detect(void)
+{
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		return 2;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return 1;
+
+	return 0;
+}
+
+const char*
+polar_mode_name(enum polar_mode mode)
+{
+	if (mode < 0 || mode >= POLAR_MODES)
+		return NULL;
+
+	return mode_names[mode];
+}
+
+void
+polar_exec(enum polar_mode mode, int fast, const float *re, const float *im,
+    float *out, int n)
+{
+	int w, body;
+	float tr[POLAR_MAXWIDTH], ti[POLAR_MAXWIDTH], to[POLAR_MAXWIDTH];
+
+	if (best_kernel == -1)
+		best_kernel = kernel_detect();
+
+	w = kernels[best_kernel].width;
+	body = n - n % w;
+
+	kernels[best_kernel].fn(mode, fast, re, im, out, body);
+
+	if (body == n)
+		return;
+
+	// the tail runs as one zero padded vector
+	memset(tr, 0, sizeof (tr));
+	memset(ti, 0, sizeof (ti));
+	memcpy(tr, re + body, (n - body) * sizeof (float));
+	memcpy(ti, im + body, (n - body) * sizeof (float));
+
+	kernels[best_kernel].fn(mode, fast, tr, ti, to, w);
+	memcpy(out + body, to, (n - body) * sizeof (float));
+}
+
+void
+polar_exec_c(enum polar_mode mode, int fast, const float *x, float *out, int n)
+{
+	int w, body;
+	float tx[2*POLAR_MAXWIDTH], to[POLAR_MAXWIDTH];
+
+	if (best_kernel == -1)
+		best_kernel = kernel_detect();
+
+	w = kernels[best_kernel].width;
+	body = n - n % w;
+
+	kernels[best_kernel].fn(mode, fast, x, NULL, out, body);
+
+	if (body == n)
+		return;
+
+	memset(tx, 0, sizeof (tx));
+	memcpy(tx, x + 2*body, 2*(n - body) * sizeof (float));
+
+	kernels[best_kernel].fn(mode, fast, tx, NULL, to, w);
+	memcpy(out + body, to, (n - body) * sizeof (float));
+}
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "pool.h"
+#include "macro.h"
+
+
+struct job {
+	void (*fn)(void *arg, int i);
+	void *arg;
+
+	int count;
+	int next;	// next index to hand out
+	int done;
+
+	struct job *link;
+};
+
+// every task is pushed once, so the indices never wrap
+struct deque {
+	pthread_mutex_t lock;
+	int *tasks;
+	int top;	// thieves take the oldest task here
+	int bottom;	// the owner pushes and pops here
+};
+
+struct graph {
+	struct pool *pool;
+
+	void (*fn)(void *arg, int i);
+	void *arg;
+
+	int *const *succ;
+	const int *nsucc;
+	int *pending;	// unfinished predecessors per task
+	int left;	// unfinished tasks
+
+	int nworkers;
+	struct deque *deques;
+};
+
+struct pool {
+	int nthreads;
+	pthread_t *threads;
+
+	pthread_mutex_t lock;
+	pthread_cond_t work;	// a job was queued
+	pthread_cond_t done;	// a job was finished
+
+	struct job *jobs;	// jobs with indices left to hand out
+};
+
+
+// must be called with the pool locked
+static int
+job_claim(struct pool *pool, struct job *job)
+{
+	struct job **p;
+	int i = job->next++;
+
+	if (job->next == job->count) {
+		for (p = &pool->jobs; *p != job; p = &(*p)->link)
+			;
+
+		*p = job->link;
+	}
+
+	return i;
+}
+
+// must be called with the pool locked
+static void
+job_run(struct pool *pool, struct job *job, int i)
+{
+	pthread_mutex_unlock(&pool->lock);
+	job->fn(job->arg, i);
+	pthread_mutex_lock(&pool->lock);
+
+	if (++job->done == job->count)
+		pthread_cond_broadcast(&pool->done);
+}
+
+static void*
+worker(void *arg)
+{
+	struct pool *pool = arg;
+
+	pthread_mutex_lock(&pool->lock);
+
+	while (1) {
+		struct job *job;
+		int i;
+
+		while (pool->jobs == NULL)
+			pthread_cond_wait(&pool->work, &pool->lock);
+
+		job = pool->jobs;
+		i = job_claim(pool, job);
+		job_run(pool, job, i);
+	}
+
+	return NULL;
+}
+
+struct pool*
+pool_new(int nthreads)
+{
+	int i;
+	struct pool *pool;
+
+	pool = xmalloc(sizeof (struct pool));
+
+	pool->nthreads = MAX(nthreads, 1);
+	pool->jobs = NULL;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	// the caller of pool_for() is the last worker
+	pool->threads = xmalloc(pool->nthreads * sizeof (pthread_t));
+
+	for (i = 0; i < pool->nthreads - 1; ++i)
+		if (pthread_create(&pool->threads[i], NULL, worker, pool) != 0)
+			error(1, "Can't create worker thread");
+
+	return pool;
+}
+
+int
+pool_size(struct pool *pool)
+{
+	return (pool == NULL) ? 1 : pool->nthreads;
+}
+
+void
+pool_for(struct pool *pool, int count, void (*fn)(void *arg, int i),
+    void *arg)
+{
+	int i;
+	struct job job;
+
+	if (count <= 0)
+		return;
+
+	if (pool == NULL || pool->nthreads == 1 || count == 1) {
+		for (i = 0; i < count; ++i)
+			fn(arg, i);
+
+		return;
+	}
+
+	job.fn = fn;
+	job.arg = arg;
+	job.count = count;
+	job.next = 0;
+	job.done = 0;
+
+	pthread_mutex_lock(&pool->lock);
+
+	job.link = pool->jobs;
+	pool->jobs = &job;
+	pthread_cond_broadcast(&pool->work);
+
+	while (job.next < job.count)
+		job_run(pool, &job, job_claim(pool, &job));
+
+	while (job.done < job.count)
+		pthread_cond_wait(&pool->done, &pool->lock);
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void
+deque_push(struct deque *d, int task)
+{
+	pthread_mutex_lock(&d->lock);
+	d->tasks[d->bottom++] = task;
+	pthread_mutex_unlock(&d->lock);
+}
+
+static int
+deque_pop(struct deque *d)
+{
+	int task = -1;
+
+	pthread_mutex_lock(&d->lock);
+	if (d->bottom > d->top)
+		task = d->tasks[--d->bottom];
+	pthread_mutex_unlock(&d->lock);
+
+	return task;
+}
+
+static int
+deque_steal(struct deque *d)
+{
+	int task = -1;
+
+	pthread_mutex_lock(&d->lock);
+	if (d->bottom > d->top)
+		task = d->tasks[d->top++];
+	pthread_mutex_unlock(&d->lock);
+
+	return task;
+}
+
+static int
+graph_queued(struct graph *g)
+{
+	int w, n;
+
+	for (w = 0; w < g->nworkers; ++w) {
+		pthread_mutex_lock(&g->deques[w].lock);
+		n = g->deques[w].bottom - g->deques[w].top;
+		pthread_mutex_unlock(&g->deques[w].lock);
+
+		if (n > 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+// wakes the workers waiting in graph_idle(); tasks are pushed before it
+static void
+graph_wake(struct graph *g)
+{
+	if (g->pool == NULL)
+		return;
+
+	pthread_mutex_lock(&g->pool->lock);
+	pthread_cond_broadcast(&g->pool->work);
+	pthread_mutex_unlock(&g->pool->lock);
+}
+
+// A worker without a task sleeps until one is queued or the graph is done,
+// meanwhile it helps with the pool_for() jobs nested in the running tasks
+static void
+graph_idle(struct graph *g)
+{
+	struct pool *pool = g->pool;
+	struct job *job;
+
+	pthread_mutex_lock(&pool->lock);
+
+	while (pool->jobs == NULL &&
+	    __atomic_load_n(&g->left, __ATOMIC_ACQUIRE) > 0 && !graph_queued(g))
+		pthread_cond_wait(&pool->work, &pool->lock);
+
+	if ((job = pool->jobs) != NULL)
+		job_run(pool, job, job_claim(pool, job));
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// any one worker finishes the graph alone, so it does not matter how many
+// of them the pool actually runs at once
+static void
+graph_worker(void *arg, int w)
+{
+	int i, s, task, woken;
+	struct graph *g = arg;
+
+	while (__atomic_load_n(&g->left, __ATOMIC_ACQUIRE) > 0) {
+		task = deque_pop(&g->deques[w]);
+
+		for (i = 1; i < g->nworkers && task == -1; ++i)
+			task = deque_steal(&g->deques[(w + i) % g->nworkers]);
+
+		if (task == -1) {
+			graph_idle(g);
+			continue;
+		}
+
+		g->fn(g->arg, task);
+
+		woken = 0;
+		for (i = 0; i < g->nsucc[task]; ++i) {
+			s = g->succ[task][i];
+
+			if (__atomic_sub_fetch(&g->pending[s], 1,
+			    __ATOMIC_ACQ_REL) == 0) {
+				deque_push(&g->deques[w], s);
+				++woken;
+			}
+		}
+
+		// the last task releases the idle workers too
+		if (__atomic_sub_fetch(&g->left, 1, __ATOMIC_RELEASE) == 0 ||
+		    woken > 1)
+			graph_wake(g);
+	}
+}
+
+void
+pool_graph(struct pool *pool, int count, const int *npred, int *const *succ,
+    const int *nsucc, void (*fn)(void *arg, int i), void *arg)
+{
+	int i, w;
+	struct graph g;
+
+	if (count <= 0)
+		return;
+
+	g.pool = pool;
+	g.fn = fn;
+	g.arg = arg;
+	g.succ = succ;
+	g.nsucc = nsucc;
+	g.left = count;
+	g.nworkers = pool_size(pool);
+
+	g.pending = xmalloc(count * sizeof (int));
+	memcpy(g.pending, npred, count * sizeof (int));
+
+	g.deques = xmalloc(g.nworkers * sizeof (struct deque));
+
+	for (w = 0; w < g.nworkers; ++w) {
+		pthread_mutex_init(&g.deques[w].lock, NULL);
+		g.deques[w].tasks = xmalloc(count * sizeof (int));
+		g.deques[w].top = g.deques[w].bottom = 0;
+	}
+
+	// the sources are dealt out round robin
+	for (i = 0, w = 0; i < count; ++i)
+		if (npred[i] == 0)
+			deque_push(&g.deques[w++ % g.nworkers], i);
+
+	pool_for(pool, g.nworkers, graph_worker, &g);
+
+	for (w = 0; w < g.nworkers; ++w) {
+		pthread_mutex_destroy(&g.deques[w].lock);
+		free(g.deques[w].tasks);
+	}
+
+	free(g.deques);
+	free(g.pending);
+}
@@ -4,26 +4,74 @@
 #include <alloca.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/soundcard.h>
 
 #include "nk.h"
+#include "fft.h"
+#include "pcm.h"
+#include "polar.h"
+#include "pool.h"
+#include "wind.h"
 #include "macro.h"
 
 #define CIRC_RAD 5
+#define CON_ALIGN 32
+#define OCON_MAX PCM_CHNLS_MAX	// the mic has an output per channel
 
 // oss settings
 #define AFMT AFMT_S16_NE
-#define CHNLS 1
+#define CHNLS 1		// unless CHNLS_ENV asks for more
 #define RATE 48000
 #define OSS_DEVNAME "/dev/dsp"
-#define MICBUF_SAMPLES 2048
+#define MICBUF_SAMPLES 2048	// longest window read from the ring
+#define MIC_HOP 512
+#define MIC_LONG_MIN 16		// log2 of the long windows the mic keeps
+#define MIC_LONG_MAX 22
 
-float micbuf[MICBUF_SAMPLES];
+#define CAP_BLOCK 256		// frames per block of silence
+#define CAP_READ 4096		// most frames per read
+#define CAP_TIMEOUT 100		// ms a poll waits for the device
+#define CAPBUF_SAMPLES 16384	// per channel, power of two
+#define CAP_LAG (CAPBUF_SAMPLES/2)	// backlog the engine skips
+
+#define PLAY_BLOCK 256		// most frames per write
+#define PLAYBUF_SAMPLES 16384	// power of two
+#define OUT_LATENCY 100		// ms queued ahead of the speaker
+#define OUT_LATENCY_MIN 20	// a pass's hop comes in one burst
+#define OUT_LATENCY_MAX 500
+
+#define STREAM_BLOCK 512
+#define STREAM_LATENCY 4	// passes a link ring holds
+#define STREAM_LATENCY_MAX 16
+#define STREAM_FIRES_MAX 4096	// per node and pass
+
+#define CHAIN_BLOCK 256	// samples a fused chain keeps in L1
+
+#define FFT_SIZE 512
+#define PLOT_POINTS 2048	// longer inputs are drawn at a stride
+#define RATE_FACTOR 2
+#define RATE_FACTOR_MAX 16
+
+#define SDFT_RESYNC 100
+#define WISDOM_FILE "fft.wisdom"
+#define THREADS_ENV "SIGNALS_THREADS"
+#define MMAP_ENV "SIGNALS_MMAP"
+#define CHNLS_ENV "SIGNALS_CHANNELS"
+#define OUTPUT_ENV "SIGNALS_OUTPUT"	// a device, file or fifo to play to
+
+#define SNAP_FRESH 4	// flag of snapshot.middle
 
 
 enum windtypes {
@@ -37,15 +85,68 @@ enum windtypes {
 	WIND_FFT,
 	WIND_REV_FFT,
 	WIND_TEE,
-
-	// plot
+	WIND_SDFT,
+	WIND_SPLIT,
+	WIND_MERGE,
+	WIND_POLAR,
+	WIND_DECIMATE,
+	WIND_INTERP,
+	WIND_GAIN,
+	WIND_CLAMP,
+
+	// sinks
 	WIND_PLOT,
+	WIND_OUTPUT,
+};
+
+enum contype {
+	CON_REAL,
+	CON_COMPLEX,	// interleaved re, im pairs
+
+	CON_ANY,	// input ports only
+};
+
+struct membuf {
+	float *buf;	// CON_ALIGN aligned
+	int size;	// in floats
 };
 
 struct connector {
-	int samples;
-	int bufsize;
-	float *buf;
+	enum contype type;
+	int samples;	// complex connectors hold 2*samples floats
+	float *buf;	// mem->buf once the producer ran
+
+	// the connector's own memory, or one shared from the pool by
+	// connectors with disjoint lifetimes
+	struct membuf own;
+	struct membuf *mem;
+
+	// samples new since the previous frame; the older ones moved hop
+	// places towards the start.  hop >= samples means all new
+	int hop;
+
+	unsigned version;	// bumped on every write
+};
+
+// FIFO of a link in streaming mode.  Writes are mirrored into the second
+// half, so any size floats from head are contiguous.
+struct ring {
+	float *buf;	// 2*size floats
+	int size;	// capacity in floats
+	int head;	// first queued float
+	int count;	// queued floats
+	int put, take;	// floats per firing of the producer and consumer
+};
+
+// Triple buffer of a plot input: the engine fills back and swaps it with
+// middle, the UI swaps front with middle when the fresh flag is set.
+struct snapshot {
+	float *buf[3];
+	int size[3];
+	int samples[3];
+
+	int back, front;
+	int middle;	// index | SNAP_FRESH, swapped atomically
 };
 
 struct node {
@@ -58,24 +159,87 @@ struct node {
 	struct connector **inp; // array pointers to input connectors
 	struct connector **out; // array pointers to output connectors
 
-	int processed;
+	struct links **ilink;	// link into each input, or NULL
+	struct links **olink;	// link out of each output, or NULL
+
+	int mark;	// visited flag of the graph walks
+	int index;	// place in the execution order, or -1
+
+	// settings and links bump version; a node runs again only when it or
+	// one of its inputs changed since the versions seen by its last run
+	unsigned version, run_version;
+	unsigned *inp_version;
+
+	// streaming: firings per pass and the current one
+	int fires, firing;
+
+	// pointwise chains run as one node, the last one; the others are
+	// fused into it
+	struct node *fuse_from;	// previous stage, or NULL
+	int fused;
 
 	union {
 		// sine settings
 		struct {
 			float step;
 			int sine_samples;
+			double sine_phase;	// in periods, streaming only
 		};
 
 		// mic settings;
 		struct {
 			float gain;
 			int mic_samples;
+			int mic_long;	// log2 of the long window, or 0
+
+			// the long window's frames, recorded pass by pass
+			int rec_size;
+			uint64_t rec_pos;
+			float *rec[PCM_CHNLS_MAX];
 		};
 
 		// plot settings
 		struct {
 			float minval, maxval;
+			struct snapshot *snap;	// one per input
+		};
+
+		// audio output settings
+		struct {
+			int out_latency;	// ms
+		};
+
+		// polar settings
+		struct {
+			int polar_mode;
+			int polar_fast;
+		};
+
+		// fft and reverse fft settings
+		struct {
+			int fft_size;	// streaming only, windows keep theirs
+		};
+
+		// decimator and interpolator settings
+		struct {
+			int rate_factor;
+		};
+
+		// gain and clamp settings
+		struct {
+			float amp;
+			float limit;	// clamps to [-limit, limit]
+		};
+
+		// sliding dft settings
+		struct {
+			int sdft_resync;	// frames between full transforms
+			int sdft_size;		// streaming only
+			int sdft_age;
+			int sdft_n;
+			double *sdft_re, *sdft_im;
+			double *sdft_wr, *sdft_wi;
+			float *sdft_hist;	// previous input window
 		};
 	};
 };
@@ -83,6 +247,11 @@ struct node {
 struct links {
 	struct node *from, *to;
 	int fcon, tcon;
+
+	// streaming mode: the queued blocks and the consumer's input, a view
+	// of the oldest one
+	struct ring ring;
+	struct connector view;
 };
 
 struct linking {
@@ -97,513 +266,2663 @@ static struct linking linking;
 static struct links *links;
 
 static int oss_fd;
-
-
-static struct links*
-find_link(struct node *from, struct node *to, int fcon, int tcon)
+static struct pool *pool;
+
+// held by the engine while it runs the graph and by the UI while it edits
+// the graph's structure
+static pthread_mutex_t graph_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t engine_thread;
+
+// set by the UI while an autotune runs next to the engine
+static int tuning;
+static pthread_t tune_thread;
+
+// nodes feeding the sinks, each after the ones it reads from, and their
+// dependencies as indices into it
+static struct node **order;
+static int norder;
+static int *npred, *nsucc;
+static int **succ;
+static int *succbuf;
+
+static struct membuf **membufs;
+static int nmembufs;
+
+// Streaming mode runs the graph on blocks of stream_block new samples
+// queued in the link rings; the others rerun nodes on whole windows.
+// Changed under graph_lock only.
+static int stream_mode;
+static int stream_block = STREAM_BLOCK;
+static int stream_latency = STREAM_LATENCY;
+
+static int stream_ok;	// the rates balance, set atomically
+static int stream_hop = STREAM_BLOCK;	// samples captured per pass
+
+static int mic_hop = MIC_HOP;	// samples of the last captured block
+
+// Single producer, single consumer ring of the captured frames, one row
+// per channel: the capture thread publishes cap_head, the engine cap_tail,
+// the oldest frame a window may still read.  Writes are mirrored into the
+// second half, so a window is a pointer into it.
+static float capbuf[PCM_CHNLS_MAX][2*CAPBUF_SAMPLES];
+static int cap_chnls = CHNLS;
+static uint64_t cap_head, cap_tail;
+static uint64_t cap_pos;	// engine: the end of the pass's samples
+static sem_t cap_sem;		// posted per captured block
+static pthread_t capture_thread;
+
+// added to atomically by the capture and engine threads
+static struct capture_stats cap_stats;
+
+// the device's input buffer when mapped, and the capture thread's place
+// in it
+static int16_t *cap_map;
+static int cap_mapsize, cap_mapptr;	// bytes
+static int cap_frags, cap_fragsize;
+
+// Single producer, single consumer ring of the outputs' mix: the engine
+// publishes play_head, the playback thread play_tail.  play_fd stays -1
+// until the playback thread opened its target.
+static float playbuf[PLAYBUF_SAMPLES];
+static uint64_t play_head, play_tail;
+static int play_target = OUT_LATENCY * RATE / 1000;	// frames
+static int play_fd = -1;
+static int play_dev, play_chnls = 1;
+static pthread_t playback_thread;
+static int play_started;	// by the first output node
+
+// SIGNALS_OUTPUT, or NULL to play on the capture device
+static const char *play_name;
+
+// the playback thread's clock of a file or fifo
+static struct timespec play_start;
+static int64_t play_written;
+
+static float *mixbuf;	// engine: the pass's mix
+static int mixsize;
+
+static struct output_stats out_stats;
+
+
+static struct connector*
+con_new(enum contype type)
 {
-	struct links *link;
+	struct connector *con;
 
-	list_foreach (links, link) {
-		if ((from == NULL || from == link->from) &&
-		    (to   == NULL || to   == link->to  ) &&
-		    (fcon == -1   || fcon == link->fcon) &&
-		    (tcon == -1   || tcon == link->tcon))
-			break;
-	}
+	con = xmalloc(sizeof (struct connector));
+	memset(con, 0, sizeof (struct connector));
+	con->type = type;
+	con->mem = &con->own;
 
-	return link;
+	return con;
 }
 
-static int
-fft(float *rex, float *imx, int n)
+static void
+con_reserve(struct connector *con, int samples)
 {
-	int i, ip, j, k;
+	int size = (con->type == CON_COMPLEX) ? 2*samples : samples;
+	struct membuf *mem = con->mem;
 
-	if (n <= 0 || rex == NULL || imx == NULL)
-		return -1;
+	if (mem->size < size) {
+		free(mem->buf);
 
-	for (i = 1, j = n/2; i < n - 1; ++i, j += k) {
-		if (i < j) {
-			SWAP(rex[i], rex[j]);
-			SWAP(imx[i], imx[j]);
-		}
+		if (posix_memalign((void**)&mem->buf, CON_ALIGN,
+		    MAX(size, 1) * sizeof (float)) != 0)
+			error(1, "Can't allocate connector buffer");
 
-		for (k = n/2; k <= j; j -= k, k /= 2)
-			;
+		mem->size = size;
 	}
 
-	for (i = 1; i <= log2(n); i++) {				//Each stage
-		int le;
-		float si, sr, ti, tr, ui, ur;
-
-		le = pow(2, i - 1);
-		sr = cos(NK_PI / le);
-		si = -sin(NK_PI / le);
-		ur = 1;
-		ui = 0;
+	con->buf = mem->buf;
+}
 
-		for (j = 1; j <= le; j++) {				//Each SUB DFT
-			for (k = j - 1; k < n; k += 2*le) {		//Each butterfly
-				ip = k + le;				//Butterfly
-				tr = rex[ip] * ur - imx[ip] * ui;
-				ti = rex[ip] * ui + imx[ip] * ur;
+static enum contype
+inp_type(struct node *node, int slot)
+{
+	switch (node->type) {
+	case WIND_REV_FFT:
+	case WIND_SPLIT:
+		return CON_COMPLEX;
 
-				rex[ip] = rex[k] - tr;
-				imx[ip] = imx[k] - ti;
+	case WIND_TEE:
+		return CON_ANY;
 
-				rex[k] = rex[k] + tr;
-				imx[k] = imx[k] + ti;
-			}
+	// complex, or the real part with the imaginary one on slot 1
+	case WIND_POLAR:
+		return (slot == 0) ? CON_ANY : CON_REAL;
 
-			tr = ur;
-			ur  = tr * sr - ui * si;
-			ui = tr * si + ui * sr;
-		}
+	default:
+		return CON_REAL;
 	}
-
-	return 0;
 }
 
+// inputs linked to a connector of the wrong type read as unlinked
 static int
-rev_fft(float *rex, float *imx, int n)
+inputs_ok(struct node *node)
 {
 	int i;
+	enum contype type;
 
-	fft(rex, imx, n);
+	for (i = 0; i < node->icon; ++i) {
+		if (node->inp[i] == NULL)
+			continue;
 
-	for (i = 0; i < n; ++i) {
-		rex[i] /= n/2;
-		imx[i] /= n/2;
+		type = inp_type(node, i);
+		if (type != CON_ANY && type != node->inp[i]->type)
+			return 0;
 	}
 
-	return 0;
+	return 1;
 }
 
+// streaming continues the phase of the previous block, the period stays
+// sine_samples/step samples
 static void
 gensin(struct node *node)
 {
 	int i;
 	int samples = node->out[0]->samples;
+	double freq;
+
+	if (!stream_mode) {
+		for (i = 0; i < samples; ++i)
+			node->out[0]->buf[i] = sin(2.0f*NK_PI*i*node->step/samples);
+		return;
+	}
+
+	freq = node->step / node->sine_samples;
 
 	for (i = 0; i < samples; ++i)
-		node->out[0]->buf[i] = sin(2.0f*NK_PI*i*node->step/samples);
+		node->out[0]->buf[i] = sin(2.0*M_PI*(node->sine_phase + i*freq));
+
+	node->sine_phase += samples * freq;
+	node->sine_phase -= floor(node->sine_phase);
+}
+
+// channel chn's samples captured before the pass's end, back samples
+// earlier; back + samples is at most MICBUF_SAMPLES
+static float*
+capture_window(int chn, int samples, int back)
+{
+	return capbuf[chn] + ((cap_pos - back - samples) &
+	    (CAPBUF_SAMPLES - 1));
 }
 
+// waits until hop samples came after the previous pass; an engine lagging
+// by more than CAP_LAG skips to the newest ones
 static void
-set_micbuf(void)
+capture_wait(int hop)
 {
-	int i;
-	int16_t buf[512];
-	int samples = MICBUF_SAMPLES;
+	uint64_t head;
+
+	while ((head = __atomic_load_n(&cap_head, __ATOMIC_ACQUIRE)) <
+	    cap_pos + hop)
+		sem_wait(&cap_sem);
+
+	// a lagging engine left posts behind for blocks head already counts;
+	// they would let the next waits spin instead of sleep
+	while (sem_trywait(&cap_sem) == 0)
+		;
+
+	if (head - cap_pos - hop > CAP_LAG) {
+		__atomic_add_fetch(&cap_stats.dropped, head - cap_pos - hop,
+		    __ATOMIC_RELAXED);
+		cap_pos = head;
+	}
+	else
+		cap_pos += hop;
 
-	memmove(micbuf, micbuf + 512, (samples - 512) * sizeof (int16_t));
-	read(oss_fd, buf, 512 * sizeof (int16_t));
+	mic_hop = hop;
 
-	for (i = 0; i < 512; ++i)
-		micbuf[samples - 512 + i] = (float)buf[i]/INT16_MAX;
+	__atomic_store_n(&cap_tail, (cap_pos > MICBUF_SAMPLES) ?
+	    cap_pos - MICBUF_SAMPLES : 0, __ATOMIC_RELEASE);
 }
 
+// The device's own errors, where it reports them, or a full device buffer
+// as an overrun of unknown size
 static void
-genmic(struct node *node)
+capture_errors(audio_buf_info *info)
 {
-	int i;
-	int samples = node->out[0]->samples;
+#ifdef SNDCTL_DSP_GETERROR
+	audio_errinfo err;
 
-	for (i = 0; i < samples; ++i)
-		node->out[0]->buf[i] = (float)node->gain * micbuf[i];
+	UNUSED(info);
+
+	if (ioctl(oss_fd, SNDCTL_DSP_GETERROR, &err) == -1)
+		return;
+
+	__atomic_add_fetch(&cap_stats.overruns, err.rec_overruns,
+	    __ATOMIC_RELAXED);
+	__atomic_add_fetch(&cap_stats.dropped,
+	    err.rec_ptradjust / (cap_chnls * sizeof (int16_t)),
+	    __ATOMIC_RELAXED);
+#else
+	if (info->fragstotal > 0 && info->fragments >= info->fragstotal)
+		__atomic_add_fetch(&cap_stats.overruns, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+// Waits for the device and reads what it has, at most max frames; 0 on a
+// timeout
+static int
+capture_read(int16_t *buf, int max)
+{
+	ssize_t size, want;
+	int known = 0;
+	ssize_t frame = cap_chnls * sizeof (int16_t);
+	audio_buf_info info;
+	struct pollfd pfd = {oss_fd, POLLIN, 0};
+
+	if (poll(&pfd, 1, CAP_TIMEOUT) <= 0)
+		return 0;
+
+	want = max * frame;
+
+	// without the device's count, any read may come short
+	if (ioctl(oss_fd, SNDCTL_DSP_GETISPACE, &info) != -1) {
+		capture_errors(&info);
+		want = MIN(want, info.bytes);
+		known = 1;
+	}
+
+	want -= want % frame;
+	if (want <= 0)
+		return 0;
+
+	if ((size = read(oss_fd, buf, want)) < want && known)
+		__atomic_add_fetch(&cap_stats.short_reads, 1, __ATOMIC_RELAXED);
+
+	return (size > 0) ? size / frame : 0;
 }
 
+// Converts n interleaved frames into the channels' rows.  A full ring
+// drops them instead of overwriting a window in use.
 static void
-tee_proc(struct node *node)
+capture_push(const int16_t *src, int n)
 {
-	size_t size;
+	int c, t;
+	float *dst[PCM_CHNLS_MAX];
+	uint64_t head = cap_head;	// only written by this thread
 
-	if (node->inp[0] == NULL)
+	if (n <= 0)
 		return;
 
-	size = node->out[0]->samples * sizeof (float);
+	if (head + n - __atomic_load_n(&cap_tail, __ATOMIC_ACQUIRE) >
+	    CAPBUF_SAMPLES) {
+		__atomic_add_fetch(&cap_stats.dropped, n, __ATOMIC_RELAXED);
+		return;
+	}
+
+	// the rows are twice as long as the ring, the frames go in one run
+	t = head & (CAPBUF_SAMPLES - 1);
+	for (c = 0; c < cap_chnls; ++c)
+		dst[c] = capbuf[c] + t;
+
+	pcm_deinterleave(src, cap_chnls, n, dst);
+
+	for (c = 0; c < cap_chnls; ++c) {
+		if (t + n <= CAPBUF_SAMPLES)
+			memcpy(dst[c] + CAPBUF_SAMPLES, dst[c],
+			    n * sizeof (float));
+		else {
+			memcpy(dst[c] + CAPBUF_SAMPLES, dst[c],
+			    (CAPBUF_SAMPLES - t) * sizeof (float));
+			memcpy(capbuf[c], capbuf[c] + CAPBUF_SAMPLES,
+			    (t + n - CAPBUF_SAMPLES) * sizeof (float));
+		}
+	}
+
+	__atomic_store_n(&cap_head, head + n, __ATOMIC_RELEASE);
+	sem_post(&cap_sem);
+}
+
+// Maps the device's input buffer and starts recording into it; 0 when the
+// device can't, capture then stays on read()
+static int
+capture_map(void)
+{
+	int caps, trig;
+	void *map;
+	audio_buf_info info;
+
+	if (ioctl(oss_fd, SNDCTL_DSP_GETCAPS, &caps) == -1 ||
+	    !(caps & DSP_CAP_MMAP) || !(caps & DSP_CAP_TRIGGER))
+		return 0;
+
+	if (ioctl(oss_fd, SNDCTL_DSP_GETISPACE, &info) == -1)
+		return 0;
+
+	cap_frags = info.fragstotal;
+	cap_fragsize = info.fragsize;
+	cap_mapsize = cap_frags * cap_fragsize;
+
+	// frames must not wrap around the end of the buffer
+	if (cap_mapsize % (cap_chnls * sizeof (int16_t)) != 0)
+		return 0;
+
+	map = mmap(NULL, cap_mapsize, PROT_READ, MAP_SHARED, oss_fd, 0);
+	if (map == MAP_FAILED)
+		return 0;
+
+	// recording restarts from the start of the buffer
+	trig = 0;
+	if (ioctl(oss_fd, SNDCTL_DSP_SETTRIGGER, &trig) != -1) {
+		trig = PCM_ENABLE_INPUT;
+
+		if (ioctl(oss_fd, SNDCTL_DSP_SETTRIGGER, &trig) != -1) {
+			cap_map = map;
+			cap_mapptr = 0;
+
+			return 1;
+		}
+	}
+
+	munmap(map, cap_mapsize);
 
-	memcpy(node->out[0]->buf, node->inp[0]->buf, size);
-	memcpy(node->out[1]->buf, node->inp[0]->buf, size);
+	return 0;
 }
 
+// Follows the device's write pointer through the mapped buffer and
+// converts the new samples straight from it, no read() in between
 static void
-fft_proc(struct node *node)
+capture_mapped(void)
 {
-	int samples;
-	size_t size;
-	float *rex, *imx;
+	int ptr, avail;
+	int frame = cap_chnls * sizeof (int16_t);
+	count_info ci;
+	struct pollfd pfd = {oss_fd, POLLIN, 0};
 
-	if (node->inp[0] == NULL)
+	struct timespec frag = {0, cap_fragsize / frame * 1000000000LL / RATE};
+
+	poll(&pfd, 1, CAP_TIMEOUT);
+
+	if (ioctl(oss_fd, SNDCTL_DSP_GETIPTR, &ci) == -1)
 		return;
 
-	samples = 2 * node->out[0]->samples;
-	size = samples * sizeof (float);
+	ptr = ci.ptr - ci.ptr % frame;
+	avail = (ptr - cap_mapptr + cap_mapsize) % cap_mapsize;
 
-	rex = alloca(size);
-	imx = alloca(size);
+	// the device lapped the buffer since the previous call, only the
+	// samples behind its pointer are left
+	if (ci.blocks >= cap_frags) {
+		__atomic_add_fetch(&cap_stats.overruns, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&cap_stats.dropped,
+		    (ci.blocks * cap_fragsize - avail) / frame,
+		    __ATOMIC_RELAXED);
+	}
 
-	memcpy(rex, node->inp[0]->buf, size);
-	memset(imx, 0, size);
+	if (avail == 0) {
+		nanosleep(&frag, NULL);
+		return;
+	}
 
-	fft(rex, imx, samples);
+	if (ptr < cap_mapptr) {
+		capture_push(cap_map + cap_mapptr / sizeof (int16_t),
+		    (cap_mapsize - cap_mapptr) / frame);
+		cap_mapptr = 0;
+	}
 
-	memcpy(node->out[0]->buf, rex, size/2);
-	memcpy(node->out[1]->buf, imx, size/2);
+	capture_push(cap_map + cap_mapptr / sizeof (int16_t),
+	    (ptr - cap_mapptr) / frame);
+	cap_mapptr = ptr;
 }
 
-static void
-rev_fft_proc(struct node *node)
+// Takes the device's samples as soon as it has them so the engine never
+// waits on it
+static void*
+capture(void *arg)
 {
-	size_t size;
-	int samples;
-	float *buf;
+	int16_t buf[CAP_READ * PCM_CHNLS_MAX];
+
+	struct timespec block = {0, CAP_BLOCK * 1000000000LL / RATE};
+
+	UNUSED(arg);
+
+	while (1) {
+		// without a device, silence comes at the device's pace
+		if (oss_fd == -1) {
+			memset(buf, 0, CAP_BLOCK * cap_chnls * sizeof (int16_t));
+			nanosleep(&block, NULL);
+			capture_push(buf, CAP_BLOCK);
+		}
+		else if (cap_map != NULL)
+			capture_mapped();
+		else
+			capture_push(buf, capture_read(buf, CAP_READ));
+	}
+
+	return NULL;
+}
+
+// Frames written but not played yet: the device's queue, or for a file or
+// fifo the frames ahead of the clock
+static int
+playback_delay(void)
+{
+	int bytes;
+	int64_t due;
+	struct timespec now;
+
+	if (play_dev && ioctl(play_fd, SNDCTL_DSP_GETODELAY, &bytes) != -1)
+		return bytes / (play_chnls * sizeof (int16_t));
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	due = (now.tv_sec - play_start.tv_sec) * RATE +
+	    (now.tv_nsec - play_start.tv_nsec) * (int64_t)RATE / 1000000000;
+
+	// a drained stand-in restarts its clock
+	if (due >= play_written) {
+		play_start = now;
+		play_written = 0;
+		return 0;
+	}
+
+	return play_written - due;
+}
+
+// Opens the output; a device plays the mix at RATE on every channel it
+// grants, a file or fifo gets the mono samples.  Without a name the
+// capture device plays too, its fd already holds the only open.
+static int
+playback_open(const char *name)
+{
+	int fd, afmt, chnls, rate;
+	int flags = O_WRONLY;
+	struct stat st;
+
+	if (name == NULL) {
+		// a mapped capture leaves the fd no write()
+		if (oss_fd == -1 || cap_map != NULL)
+			return -1;
+
+		play_dev = 1;
+		play_chnls = cap_chnls;
+		clock_gettime(CLOCK_MONOTONIC, &play_start);
+		__atomic_store_n(&play_fd, oss_fd, __ATOMIC_RELEASE);
+
+		return 0;
+	}
+
+	// only files are created, a device is used as it is
+	if (stat(name, &st) == -1 || !S_ISCHR(st.st_mode))
+		flags |= O_CREAT | O_TRUNC;
+
+	// a fifo waits here for its reader
+	if ((fd = open(name, flags, 0644)) == -1)
+		return -1;
+
+	afmt = AFMT;
+	chnls = 1;
+	rate = RATE;
+
+	play_dev = (ioctl(fd, SNDCTL_DSP_SETFMT, &afmt) != -1);
+
+	if (play_dev && (afmt != AFMT ||
+	    ioctl(fd, SNDCTL_DSP_CHANNELS, &chnls) == -1 ||
+	    chnls < 1 || chnls > PCM_CHNLS_MAX ||
+	    ioctl(fd, SNDCTL_DSP_SPEED, &rate) == -1 || rate != RATE)) {
+		close(fd);
+		return -1;
+	}
+
+	play_chnls = play_dev ? chnls : 1;
+	clock_gettime(CLOCK_MONOTONIC, &play_start);
+	__atomic_store_n(&play_fd, fd, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+// writes all of size bytes, waiting for room on a non-blocking device
+static int
+playback_write(const void *buf, size_t size)
+{
+	ssize_t n;
+	const char *p = buf;
+	struct pollfd pfd = {play_fd, POLLOUT, 0};
+
+	while (size > 0) {
+		if ((n = write(play_fd, p, size)) == -1) {
+			if (errno == EAGAIN)
+				poll(&pfd, 1, CAP_TIMEOUT);
+			else if (errno != EINTR)
+				return -1;
+			continue;
+		}
+
+		p += n;
+		size -= n;
+	}
+
+	return 0;
+}
+
+// Keeps the target latency queued ahead of the speaker.  A backlog beyond
+// it is dropped instead of adding delay, an empty ring when the output
+// drained is an underrun.
+static void*
+playback(void *arg)
+{
+	int i, c, n, delay, target;
+	int playing = 0;
+	uint64_t head, tail;
+	float x;
+	int16_t buf[PLAY_BLOCK * PCM_CHNLS_MAX];
+	const char *name = (arg != NULL) ? arg : OSS_DEVNAME;
+
+	struct timespec block = {0, PLAY_BLOCK * 1000000000LL / RATE};
+
+	if (playback_open(arg) == -1) {
+		warning("Can't open %s for playback", name);
+		return NULL;
+	}
+
+	while (1) {
+		target = __atomic_load_n(&play_target, __ATOMIC_RELAXED);
+		delay = playback_delay();
+		head = __atomic_load_n(&play_head, __ATOMIC_ACQUIRE);
+		tail = play_tail;	// only written by this thread
+
+		if (head == tail && delay == 0 && playing) {
+			__atomic_add_fetch(&out_stats.underruns, 1,
+			    __ATOMIC_RELAXED);
+			playing = 0;
+		}
+
+		if (head == tail || delay >= target) {
+			nanosleep(&block, NULL);
+			continue;
+		}
+
+		if (head - tail > (uint64_t)target) {
+			__atomic_add_fetch(&out_stats.dropped,
+			    head - tail - target, __ATOMIC_RELAXED);
+			tail = head - target;
+		}
+
+		n = MIN(MIN(target - delay, (int)(head - tail)), PLAY_BLOCK);
+
+		for (i = 0; i < n; ++i) {
+			x = playbuf[(tail + i) & (PLAYBUF_SAMPLES - 1)];
+			x = MAX(MIN(x, 1.0f), -1.0f);
+
+			for (c = 0; c < play_chnls; ++c)
+				buf[i*play_chnls + c] = lrintf(x * INT16_MAX);
+		}
+
+		__atomic_store_n(&play_tail, tail + n, __ATOMIC_RELEASE);
 
-	if (node->inp[0] == NULL || node->inp[1] == NULL)
+		// the outputs go quiet once the target is gone
+		if (playback_write(buf, n * play_chnls * sizeof (int16_t)) ==
+		    -1) {
+			warning("Can't write to %s", name);
+			if (play_fd != oss_fd)
+				close(play_fd);
+			__atomic_store_n(&play_fd, -1, __ATOMIC_RELEASE);
+			return NULL;
+		}
+
+		play_written += n;
+		playing = 1;
+	}
+
+	return NULL;
+}
+
+// the first output node starts the playback, a graph without one leaves
+// the output alone
+static void
+playback_begin(void)
+{
+	if (play_started)
 		return;
 
-	samples = node->out[0]->samples;
-	size = samples * sizeof (float);
-	buf = alloca(size);
+	play_started = 1;
 
-	memcpy(node->out[0]->buf, node->inp[0]->buf, size/2);
-	memset(node->out[0]->buf + samples/2, 0, size/2);
-	memcpy(buf, node->inp[1]->buf, size/2);
-	memset(buf + samples/2, 0, size/2);
+	// a fifo's reader may leave, that only silences the outputs
+	signal(SIGPIPE, SIG_IGN);
 
-	rev_fft(buf, node->out[0]->buf, samples);
+	if (pthread_create(&playback_thread, NULL, playback,
+	    (void*)play_name) != 0)
+		error(1, "Can't create playback thread");
 }
 
+// Windows longer than the capture ring keeps: every pass appends its hop
+// to the node's own ring, the output is the ring from its oldest frame.
 static void
-signal_proc_rec(struct node *node)
+genmic_long(struct node *node)
 {
-	int i;
-	struct links *link;
-	int *samples;
-	int bufsize;
-	float *buf;
-	int conn_count;
+	int i, c;
+	int size = node->out[0]->samples;
+	int hop = MIN(mic_hop, MICBUF_SAMPLES);
+	int t, n;	// where the hop goes, the part before the wrap
+	int old;	// where the oldest frame is after it
+	float gain = node->gain;
+	float *mic, *rec, *out;
+
+	if (node->rec_size != size) {
+		for (c = 0; c < node->ocon; ++c) {
+			free(node->rec[c]);
+			node->rec[c] = xmalloc(size * sizeof (float));
+			memset(node->rec[c], 0, size * sizeof (float));
+		}
+
+		node->rec_size = size;
+		node->rec_pos = 0;
+	}
+
+	t = node->rec_pos & (size - 1);
+	n = MIN(hop, size - t);
+	node->rec_pos += hop;
+	old = node->rec_pos & (size - 1);
+
+	for (c = 0; c < node->ocon; ++c) {
+		mic = capture_window(c, hop, 0);
+		rec = node->rec[c];
+		out = node->out[c]->buf;
+
+		memcpy(rec + t, mic, n * sizeof (float));
+		memcpy(rec, mic + n, (hop - n) * sizeof (float));
+
+		for (i = 0; i < size - old; ++i)
+			out[i] = gain * rec[old + i];
+		for (i = 0; i < old; ++i)
+			out[size - old + i] = gain * rec[i];
+
+		node->out[c]->hop = mic_hop;
+	}
+}
+
+// an output per captured channel
+static void
+genmic(struct node *node)
+{
+	int i, c;
+	int samples = node->out[0]->samples;
+	int back = 0;
+	float *mic;
 
-	if (node == NULL || node->processed)
+	if (!stream_mode && samples > MICBUF_SAMPLES) {
+		genmic_long(node);
 		return;
+	}
 
-	switch (node->type) {
-		case WIND_MENU:
-			return;
+	// the pass captured a block for each firing
+	if (stream_mode)
+		back = (node->fires - 1 - node->firing) * samples;
 
-		case WIND_PLOT:
-			link = find_link(NULL, node, -1, 0);
-			if (link != NULL)
-				return;
+	for (c = 0; c < node->ocon; ++c) {
+		mic = capture_window(c, samples, back);
 
-			signal_proc_rec(link->from);
+		for (i = 0; i < samples; ++i)
+			node->out[c]->buf[i] = (float)node->gain * mic[i];
+
+		node->out[c]->hop = mic_hop;
+	}
+}
+
+// Tee outputs alias the input: nodes only read their inputs, so none
+// needs a copy of its own
+static void
+tee_proc(struct node *node)
+{
+	int i;
+	struct connector *inp = node->inp[0];
+	struct connector *out;
+
+	for (i = 0; i < node->ocon; ++i) {
+		out = node->out[i];
+		out->buf = (inp != NULL) ? inp->buf : NULL;
+
+		if (inp != NULL)
+			out->hop = inp->hop;
+	}
+}
+
+static void
+fft_proc(struct node *node)
+{
+	int i;
+	int samples;
+	size_t size;
+	float *rex, *imx, *out;
+	struct fft_plan *plan;
+
+	if (node->inp[0] == NULL || node->out[0]->samples == 0)
+		return;
+
+	samples = node->inp[0]->samples;
+	if ((plan = fft_plan_get(samples)) == NULL)
+		return;
+
+	out = node->out[0]->buf;
+
+	if (samples % 2 == 0) {
+		fft_exec_real_c(plan, node->inp[0]->buf, out);
+
+		// drop the packed Nyquist bin, the node only outputs bins below it
+		out[1] = 0;
+
+		return;
+	}
+
+	size = samples * sizeof (float);
+
+	rex = alloca(size);
+	imx = alloca(size);
+
+	memcpy(rex, node->inp[0]->buf, size);
+	memset(imx, 0, size);
+
+	fft_exec(plan, rex, imx);
+
+	for (i = 0; i < node->out[0]->samples; ++i) {
+		out[2*i] = rex[i];
+		out[2*i + 1] = imx[i];
+	}
+}
+
+static void
+rev_fft_proc(struct node *node)
+{
+	int i;
+	int samples;
+	float dc, nyq;
+	float *out;
+	struct fft_plan *plan;
+
+	if (node->inp[0] == NULL || node->out[0]->samples == 0)
+		return;
+
+	samples = node->out[0]->samples;
+	if ((plan = fft_plan_get(samples)) == NULL)
+		return;
+
+	out = node->out[0]->buf;
+	fft_exec_real_inv_c(plan, node->inp[0]->buf, out);
+
+	// only the positive half of the spectrum is given: its hermitian
+	// extension needs a doubled DC and no Nyquist bin, while the inverse
+	// took the imaginary part of bin 0 as the Nyquist one
+	dc = node->inp[0]->buf[0];
+	nyq = node->inp[0]->buf[1];
+
+	for (i = 0; i < samples; ++i)
+		out[i] = (out[i] + dc - ((i % 2) ? -nyq : nyq)) / samples;
+}
+
+static void
+split_proc(struct node *node)
+{
+	int i;
+	float *buf;
+
+	if (node->inp[0] == NULL)
+		return;
+
+	buf = node->inp[0]->buf;
+
+	for (i = 0; i < node->out[0]->samples; ++i) {
+		node->out[0]->buf[i] = buf[2*i];
+		node->out[1]->buf[i] = buf[2*i + 1];
+	}
+}
+
+static void
+merge_proc(struct node *node)
+{
+	int i;
+	float *buf = node->out[0]->buf;
+
+	for (i = 0; i < node->out[0]->samples; ++i) {
+		buf[2*i]     = (node->inp[0] != NULL) ? node->inp[0]->buf[i] : 0;
+		buf[2*i + 1] = (node->inp[1] != NULL) ? node->inp[1]->buf[i] : 0;
+	}
+}
+
+static void
+polar_proc(struct node *node)
+{
+	int samples = node->out[0]->samples;
+	size_t size = samples * sizeof (float);
+	float *im;
+
+	if (node->inp[0] == NULL)
+		return;
+
+	if (node->inp[0]->type == CON_COMPLEX) {
+		polar_exec_c(node->polar_mode, node->polar_fast,
+		    node->inp[0]->buf, node->out[0]->buf, samples);
+		return;
+	}
+
+	if (node->inp[1] != NULL)
+		im = node->inp[1]->buf;
+	else {
+		im = alloca(size);
+		memset(im, 0, size);
+	}
+
+	polar_exec(node->polar_mode, node->polar_fast, node->inp[0]->buf, im,
+	    node->out[0]->buf, samples);
+}
+
+// the stages of pointwise nodes, dst may be src
+static void
+stage_run(struct node *node, float *dst, const float *src, int n)
+{
+	int i;
+	float amp = node->amp;
+	float limit = node->limit;
+
+	if (node->type == WIND_GAIN) {
+		for (i = 0; i < n; ++i)
+			dst[i] = src[i] * amp;
+	}
+	else {
+		for (i = 0; i < n; ++i)
+			dst[i] = MIN(MAX(src[i], -limit), limit);
+	}
+}
+
+static int
+node_pointwise(struct node *node)
+{
+	return node->type == WIND_GAIN || node->type == WIND_CLAMP;
+}
+
+// sample for sample, the window slides as the input's did
+static void
+pointwise_proc(struct node *node)
+{
+	if (node->inp[0] == NULL)
+		return;
+
+	node->out[0]->hop = node->inp[0]->hop;
+	stage_run(node, node->out[0]->buf, node->inp[0]->buf,
+	    node->out[0]->samples);
+}
+
+static struct node*
+chain_head(struct node *node)
+{
+	while (node->fuse_from != NULL)
+		node = node->fuse_from;
+
+	return node;
+}
+
+// Runs a fused chain from the head's input into the tail's output a block
+// at a time, every stage over the block while it stays in L1.  Stages are
+// the ones of the unfused nodes, so are the results.
+static void
+chain_run(struct node *tail)
+{
+	int i, k, off, n;
+	int samples;
+	float tmp[2][CHAIN_BLOCK];
+	struct node *stages[nodecount];
+	struct node *node;
+	struct connector *inp = chain_head(tail)->inp[0];
+	struct connector *out = tail->out[0];
+	int nstages = 0;
+
+	for (node = tail; node != NULL; node = node->fuse_from)
+		stages[nstages++] = node;
+
+	samples = (inp != NULL) ? inp->samples : 0;
+
+	out->samples = samples;
+	out->hop = (inp != NULL) ? inp->hop : samples;
+	++out->version;
+	con_reserve(out, samples);
+
+	if (inp == NULL || inp->type != CON_REAL)
+		return;
+
+	for (off = 0; off < samples; off += n) {
+		n = MIN(CHAIN_BLOCK, samples - off);
+
+		// the stages go back and forth between two blocks: in place,
+		// the overlap check would keep the loops scalar
+		k = 0;
+		stage_run(stages[nstages - 1], tmp[k], inp->buf + off, n);
+		for (i = nstages - 2; i > 0; --i, k ^= 1)
+			stage_run(stages[i], tmp[k ^ 1], tmp[k], n);
+		stage_run(tail, out->buf + off, tmp[k], n);
+	}
+}
+
+// averages each run of rate_factor samples before keeping one, which damps
+// what would alias above the new Nyquist frequency
+static void
+decimate_proc(struct node *node)
+{
+	int i, j;
+	int d = node->rate_factor;
+	float sum;
+	float *in;
+
+	if (node->inp[0] == NULL)
+		return;
+
+	in = node->inp[0]->buf;
+
+	for (i = 0; i < node->out[0]->samples; ++i) {
+		sum = 0;
+		for (j = 0; j < d; ++j)
+			sum += in[i*d + j];
+
+		node->out[0]->buf[i] = sum / d;
+	}
+}
+
+// holds each sample for rate_factor samples
+static void
+interp_proc(struct node *node)
+{
+	int i, j;
+	int l = node->rate_factor;
+	float *out;
+
+	if (node->inp[0] == NULL)
+		return;
+
+	out = node->out[0]->buf;
+
+	for (i = 0; i < node->inp[0]->samples; ++i)
+		for (j = 0; j < l; ++j)
+			out[i*l + j] = node->inp[0]->buf[i];
+}
+
+static void
+sdft_resize(struct node *node, int n)
+{
+	int k;
+	int bins = n/2;
+
+	node->sdft_n = n;
+	node->sdft_re = xrealloc(node->sdft_re, bins * sizeof (double));
+	node->sdft_im = xrealloc(node->sdft_im, bins * sizeof (double));
+	node->sdft_wr = xrealloc(node->sdft_wr, bins * sizeof (double));
+	node->sdft_wi = xrealloc(node->sdft_wi, bins * sizeof (double));
+	node->sdft_hist = xrealloc(node->sdft_hist, n * sizeof (float));
+
+	for (k = 0; k < bins; ++k) {
+		node->sdft_wr[k] = cos(2.0*M_PI*k/n);
+		node->sdft_wi[k] = sin(2.0*M_PI*k/n);
+	}
+}
+
+static void
+sdft_resync(struct node *node)
+{
+	int k;
+	int n = node->sdft_n;
+	int bins = n/2;
+	size_t size = n * sizeof (float);
+	float *rex, *imx;
+	struct fft_plan *plan;
+
+	if ((plan = fft_plan_get(n)) == NULL)
+		return;
+
+	rex = alloca(size);
+	imx = alloca(size);
+
+	if (n % 2 == 0) {
+		fft_exec_real(plan, node->inp[0]->buf, rex, imx);
+		imx[0] = 0;
+	}
+	else {
+		memcpy(rex, node->inp[0]->buf, size);
+		memset(imx, 0, size);
+		fft_exec(plan, rex, imx);
+	}
+
+	for (k = 0; k < bins; ++k) {
+		node->sdft_re[k] = rex[k];
+		node->sdft_im[k] = imx[k];
+	}
+
+	node->sdft_age = 0;
+}
+
+// each new sample updates every bin as X = (X + new - old) * w^k
+static void
+sdft_proc(struct node *node)
+{
+	int k, t;
+	int n, bins, hop;
+	float *buf, *d;
+
+	if (node->inp[0] == NULL || node->out[0]->samples == 0)
+		return;
+
+	n = node->inp[0]->samples;
+	bins = n/2;
+	hop = node->inp[0]->hop;
+	buf = node->inp[0]->buf;
+
+	// the hop is only trusted when the window really slid by it
+	if (n != node->sdft_n) {
+		sdft_resize(node, n);
+		sdft_resync(node);
+	}
+	else if (hop <= 0 || hop >= n || ++node->sdft_age >= node->sdft_resync ||
+	    memcmp(buf, node->sdft_hist + hop, (n - hop) * sizeof (float)))
+		sdft_resync(node);
+	else {
+		d = alloca(hop * sizeof (float));
+
+		for (t = 0; t < hop; ++t)
+			d[t] = buf[n - hop + t] - node->sdft_hist[t];
+
+		for (k = 0; k < bins; ++k) {
+			double re = node->sdft_re[k], im = node->sdft_im[k];
+			double wr = node->sdft_wr[k], wi = node->sdft_wi[k];
+
+			for (t = 0; t < hop; ++t) {
+				double tr = re + d[t];
+
+				re = tr * wr - im * wi;
+				im = tr * wi + im * wr;
+			}
+
+			node->sdft_re[k] = re;
+			node->sdft_im[k] = im;
+		}
+	}
+
+	memcpy(node->sdft_hist, buf, n * sizeof (float));
+
+	for (k = 0; k < bins; ++k) {
+		node->out[0]->buf[2*k] = node->sdft_re[k];
+		node->out[0]->buf[2*k + 1] = node->sdft_im[k];
+	}
+}
+
+static int
+node_dirty(struct node *node)
+{
+	int i;
+	int dirty = 0;
+
+	// the mic has new samples every frame
+	if (node->type == WIND_GEN_MIC || node->version != node->run_version)
+		dirty = 1;
+
+	node->run_version = node->version;
+
+	for (i = 0; i < node->icon; ++i) {
+		if (node->inp[i] == NULL ||
+		    node->inp[i]->version == node->inp_version[i])
+			continue;
+
+		node->inp_version[i] = node->inp[i]->version;
+		dirty = 1;
+	}
+
+	return dirty;
+}
+
+// sizes the outputs and runs the node
+static void
+node_run(struct node *node)
+{
+	int i;
+	struct connector **inp = node->inp;
+	int samples[OCON_MAX];
+
+	if (node->fuse_from != NULL) {
+		chain_run(node);
+		return;
+	}
+
+	for (i = 0; i < node->ocon; ++i)
+		samples[i] = node->out[i]->samples;
+
+	switch (node->type) {
+	case WIND_GEN_SIN:
+		samples[0] = stream_mode ? stream_block : node->sine_samples;
+		break;
+
+	case WIND_GEN_MIC:
+		for (i = 0; i < node->ocon; ++i)
+			samples[i] = stream_mode ? stream_block :
+			    (node->mic_long != 0) ? 1 << node->mic_long :
+			    node->mic_samples;
+		break;
+
+	case WIND_FFT:
+	case WIND_SDFT:
+		if (inp[0] != NULL)
+			samples[0] = inp[0]->samples/2;
+		break;
+
+	case WIND_REV_FFT:
+		if (inp[0] != NULL)
+			samples[0] = inp[0]->samples*2;
+		break;
+
+	// aliased outputs must not outlive the input
+	case WIND_TEE:
+		samples[0] = samples[1] = 0;
+		if (inp[0] != NULL)
+			node->out[0]->type = node->out[1]->type = inp[0]->type;
+		// fallthrough
+	case WIND_SPLIT:
+		if (inp[0] != NULL)
+			samples[0] = samples[1] = inp[0]->samples;
+		break;
+
+	case WIND_MERGE:
+		if (inp[0] != NULL && inp[1] != NULL)
+			samples[0] = MIN(inp[0]->samples, inp[1]->samples);
+		else if (inp[0] != NULL || inp[1] != NULL)
+			samples[0] = (inp[0] != NULL) ? inp[0]->samples :
+			    inp[1]->samples;
+		break;
+
+	case WIND_DECIMATE:
+		if (inp[0] != NULL)
+			samples[0] = inp[0]->samples / node->rate_factor;
+		break;
+
+	case WIND_GAIN:
+	case WIND_CLAMP:
+		if (inp[0] != NULL)
+			samples[0] = inp[0]->samples;
+		break;
+
+	case WIND_INTERP:
+		if (inp[0] != NULL)
+			samples[0] = inp[0]->samples * node->rate_factor;
+		break;
+
+	case WIND_POLAR:
+		if (inp[0] == NULL)
+			break;
+
+		samples[0] = inp[0]->samples;
+		if (inp[0]->type == CON_REAL && inp[1] != NULL)
+			samples[0] = MIN(samples[0], inp[1]->samples);
+		break;
+
+	default:
+		break;
+	}
+
+	for (i = 0; i < node->ocon; ++i) {
+		node->out[i]->samples = samples[i];
+		node->out[i]->hop = samples[i];
+		++node->out[i]->version;
+
+		// tee outputs own no memory
+		if (node->type != WIND_TEE)
+			con_reserve(node->out[i], samples[i]);
+	}
+
+	if (!inputs_ok(node))
+		return;
+
+	if (node->type == WIND_FFT)
+		fft_proc(node);
+	else if (node->type == WIND_REV_FFT)
+		rev_fft_proc(node);
+	else if (node->type == WIND_SDFT)
+		sdft_proc(node);
+	else if (node->type == WIND_SPLIT)
+		split_proc(node);
+	else if (node->type == WIND_MERGE)
+		merge_proc(node);
+	else if (node->type == WIND_POLAR)
+		polar_proc(node);
+	else if (node->type == WIND_DECIMATE)
+		decimate_proc(node);
+	else if (node->type == WIND_INTERP)
+		interp_proc(node);
+	else if (node_pointwise(node))
+		pointwise_proc(node);
+	else if (node->type == WIND_TEE)
+		tee_proc(node);
+	else if (node->type == WIND_GEN_MIC)
+		genmic(node);
+	else if (node->type == WIND_GEN_SIN)
+		gensin(node);
+}
+
+// plots and outputs read their inputs once the pass ran
+static int
+node_sink(struct node *node)
+{
+	return node->type == WIND_PLOT || node->type == WIND_OUTPUT;
+}
+
+// sinks and the ordered nodes consume their rings, the others would only
+// fill them up
+static int
+ring_used(struct links *link)
+{
+	return link->to->index != -1 || node_sink(link->to);
+}
+
+// sized once per schedule, the rings restart empty
+static void
+ring_reserve(struct ring *ring, int size)
+{
+	if (ring->size != size) {
+		free(ring->buf);
+
+		if (posix_memalign((void**)&ring->buf, CON_ALIGN,
+		    2 * MAX(size, 1) * sizeof (float)) != 0)
+			error(1, "Can't allocate link ring");
+
+		ring->size = size;
+	}
+
+	ring->head = ring->count = 0;
+}
+
+static void
+ring_push(struct links *link, struct connector *con)
+{
+	int t, n;
+	struct ring *ring = &link->ring;
+
+	n = (con->type == CON_COMPLEX) ? 2*con->samples : con->samples;
+	if (n == 0 || n > ring->size || con->buf == NULL)
+		return;
+
+	// a full ring drops its oldest samples
+	if (ring->count + n > ring->size) {
+		ring->head = (ring->head + ring->count + n - ring->size) %
+		    ring->size;
+		ring->count = ring->size - n;
+	}
+
+	t = (ring->head + ring->count) % ring->size;
+	memcpy(ring->buf + t, con->buf, n * sizeof (float));
+
+	if (t + n <= ring->size)
+		memcpy(ring->buf + t + ring->size, con->buf, n * sizeof (float));
+	else {
+		memcpy(ring->buf + t + ring->size, con->buf,
+		    (ring->size - t) * sizeof (float));
+		memcpy(ring->buf, con->buf + ring->size - t,
+		    (t + n - ring->size) * sizeof (float));
+	}
+
+	ring->count += n;
+}
+
+// points the view at the oldest samples a firing takes, or at the newest
+// ones while dropping all the others; 0 when too few are queued
+static int
+ring_view(struct links *link, int newest)
+{
+	struct ring *ring = &link->ring;
+
+	if (ring->take == 0 || ring->count < ring->take)
+		return 0;
+
+	if (newest) {
+		ring->head = (ring->head + ring->count - ring->take) %
+		    ring->size;
+		ring->count = ring->take;
+	}
+
+	link->view.buf = ring->buf + ring->head;
+	++link->view.version;
+
+	return 1;
+}
+
+static void
+ring_pop(struct links *link)
+{
+	struct ring *ring = &link->ring;
+
+	ring->head = (ring->head + ring->take) % ring->size;
+	ring->count -= ring->take;
+}
+
+// whether every linked input has a firing's samples queued and every used
+// output ring room for the ones it produces; a fused chain reads the
+// inputs of its head
+static int
+stream_ready(struct node *node)
+{
+	int i;
+	struct ring *ring;
+	struct links *link;
+	struct node *head = chain_head(node);
+
+	for (i = 0; i < head->icon; ++i) {
+		if ((link = head->ilink[i]) == NULL)
+			continue;
+
+		ring = &link->ring;
+		if (ring->take == 0 || ring->count < ring->take)
+			return 0;
+	}
+
+	for (i = 0; i < node->ocon; ++i) {
+		if ((link = node->olink[i]) == NULL || !ring_used(link))
+			continue;
+
+		ring = &link->ring;
+		if (ring->size - ring->count < ring->put)
+			return 0;
+	}
+
+	return 1;
+}
+
+// a firing consumes its samples from every linked input and queues the
+// ones it produces on every used output
+static void
+node_fire(struct node *node)
+{
+	int i;
+	struct links *link;
+	struct node *head = chain_head(node);
+
+	for (i = 0; i < head->icon; ++i)
+		if ((link = head->ilink[i]) != NULL)
+			ring_view(link, 0);
+
+	node_run(node);
+
+	for (i = 0; i < node->ocon; ++i)
+		if ((link = node->olink[i]) != NULL && ring_used(link))
+			ring_push(link, node->out[i]);
+
+	for (i = 0; i < head->icon; ++i)
+		if ((link = head->ilink[i]) != NULL)
+			ring_pop(link);
+}
+
+// every node fires as often as the schedule says, after all its inputs
+// did; a node with no linked input has nothing to stream
+static void
+node_stream(struct node *node)
+{
+	int i;
+	struct node *head = chain_head(node);
+	int linked = (head->icon == 0);
+
+	for (i = 0; i < head->icon; ++i)
+		if (head->ilink[i] != NULL)
+			linked = 1;
+
+	for (node->firing = 0; node->firing < node->fires; ++node->firing) {
+		if (!linked || !stream_ready(node))
+			break;
+
+		node_fire(node);
+	}
+}
+
+// the tail of a fused chain runs it when any stage changed
+static void
+node_proc(struct node *node)
+{
+	struct node *stage;
+	int dirty = 0;
+
+	if (node->fused)
+		return;
+
+	if (!stream_mode) {
+		for (stage = node; stage != NULL; stage = stage->fuse_from)
+			dirty |= node_dirty(stage);
+
+		if (dirty)
+			node_run(node);
+	}
+	else if (stream_ok)
+		node_stream(node);
+}
+
+static void
+node_task(void *arg, int i)
+{
+	UNUSED(arg);
+
+	node_proc(order[i]);
+}
+
+// independent branches run in parallel on the pool
+static void
+signal_proc(void)
+{
+	pool_graph(pool, norder, npred, succ, nsucc, node_task, NULL);
+}
+
+static void
+marks_clear(void)
+{
+	struct node *node;
+
+	list_foreach (wind_nodes, node) {
+		node->mark = 0;
+		node->index = -1;
+	}
+}
+
+// whether data flows from a to b
+static int
+feeds(struct node *a, struct node *b)
+{
+	int i;
+	struct links *link;
+
+	if (a == b)
+		return 1;
+
+	if (a->mark)
+		return 0;
+
+	a->mark = 1;
+
+	for (i = 0; i < a->ocon; ++i)
+		if ((link = a->olink[i]) != NULL && feeds(link->to, b))
+			return 1;
+
+	return 0;
+}
+
+static void
+compile_rec(struct node *node)
+{
+	int i;
+	struct links *link;
+
+	if (node->mark)
+		return;
+
+	node->mark = 1;
+
+	for (i = 0; i < node->icon; ++i)
+		if ((link = node->ilink[i]) != NULL)
+			compile_rec(link->from);
+
+	node->index = norder;
+	order[norder++] = node;
+}
+
+// pool entries stay allocated, only their assignment changes
+static struct membuf*
+membuf_get(int i)
+{
+	if (i == nmembufs) {
+		membufs = xrealloc(membufs, (nmembufs + 1) *
+		    sizeof (struct membuf*));
+		membufs[i] = xmalloc(sizeof (struct membuf));
+		memset(membufs[i], 0, sizeof (struct membuf));
+		++nmembufs;
+	}
+
+	return membufs[i];
+}
+
+// Narrows after, the nodes coming after all readers so far, by the readers
+// of a link's data, following the Tees that alias it.  -1 when a plot
+// reads it after the frame.
+static int
+readers_after(struct links *link, uint64_t *after, const uint64_t *reach,
+    int words)
+{
+	int i;
+	struct node *to;
+
+	if (link == NULL)
+		return 0;
+
+	// a fused chain reads its head's input when its tail runs
+	for (to = link->to; to->fused; to = to->olink[0]->to)
+		;
+
+	if (node_sink(to))
+		return -1;
+	if (to->index == -1)
+		return 0;
+
+	for (i = 0; i < words; ++i)
+		after[i] &= reach[to->index*words + i];
+
+	// the tee's readers read the same memory
+	if (to->type == WIND_TEE) {
+		for (i = 0; i < to->ocon; ++i)
+			if (readers_after(to->olink[i], after, reach,
+			    words) == -1)
+				return -1;
+	}
+
+	return 0;
+}
+
+// Outputs of the nodes running every frame, the ones downstream of a mic,
+// are only read within the frame; the other nodes keep their outputs
+// across frames and plots read theirs after the frame.  Two transient
+// outputs share memory when the producer of the later one comes after the
+// producer and the readers of the earlier one in every parallel schedule.
+static void
+graph_alloc(void)
+{
+	int i, j, k, b;
+	int nused = 0;
+	int words = (norder + 63) / 64;
+	uint64_t *reach, *after, *cur;
+	int *live;
+	struct node *node;
+
+	list_foreach (wind_nodes, node)
+		for (j = 0; j < node->ocon; ++j)
+			node->out[j]->mem = &node->out[j]->own;
+
+	reach = xmalloc(MAX(norder * words, 1) * sizeof (uint64_t));
+	memset(reach, 0, norder * words * sizeof (uint64_t));
+
+	// nodes reachable from node i, successors come later in the order
+	for (i = norder - 1; i >= 0; --i) {
+		for (j = 0; j < nsucc[i]; ++j) {
+			k = succ[i][j];
+
+			for (b = 0; b < words; ++b)
+				reach[i*words + b] |= reach[k*words + b];
+			reach[i*words + k/64] |= 1ULL << (k % 64);
+		}
+	}
+
+	// per pool entry, a node has at most OCON_MAX outputs
+	after = xmalloc(MAX(OCON_MAX * norder * words, 1) * sizeof (uint64_t));
+	cur = xmalloc(MAX(words, 1) * sizeof (uint64_t));
+	live = xmalloc(MAX(norder, 1) * sizeof (int));
+
+	for (i = 0; i < norder; ++i) {
+		node = order[i];
+		live[i] = (node->type == WIND_GEN_MIC);
+
+		for (j = 0; j < node->icon; ++j)
+			if (node->ilink[j] != NULL &&
+			    live[node->ilink[j]->from->index])
+				live[i] = 1;
+
+		// fused stages write nothing
+		if (!live[i] || node->fused)
+			continue;
+
+		for (j = 0; j < node->ocon; ++j) {
+			if (node->type == WIND_TEE)
+				continue;
+
+			memcpy(cur, reach + i*words, words * sizeof (uint64_t));
+			if (readers_after(node->olink[j], cur, reach, words) == -1)
+				continue;
+
+			for (b = 0; b < nused; ++b)
+				if (after[b*words + i/64] & (1ULL << (i % 64)))
+					break;
+
+			if (b == nused)
+				++nused;
+
+			node->out[j]->mem = membuf_get(b);
+			memcpy(after + b*words, cur, words * sizeof (uint64_t));
+		}
+	}
+
+	free(live);
+	free(cur);
+	free(after);
+	free(reach);
+}
+
+// Samples a node consumes on an input or produces on an output per firing
+// in streaming mode.  Pointwise nodes take a single one.
+static int
+port_rate(struct node *node, int out)
+{
+	switch (node->type) {
+	case WIND_GEN_SIN:
+	case WIND_GEN_MIC:
+		return stream_block;
+
+	case WIND_FFT:
+		return out ? node->fft_size/2 : node->fft_size;
+
+	case WIND_REV_FFT:
+		return out ? node->fft_size : node->fft_size/2;
+
+	case WIND_SDFT:
+		return out ? node->sdft_size/2 : node->sdft_size;
+
+	case WIND_DECIMATE:
+		return out ? 1 : node->rate_factor;
+
+	case WIND_INTERP:
+		return out ? node->rate_factor : 1;
+
+	default:
+		return 1;
+	}
+}
+
+// whether a run of firings works as one firing on all their samples
+static int
+node_blockable(struct node *node)
+{
+	switch (node->type) {
+	case WIND_GEN_SIN:
+	case WIND_GEN_MIC:
+	case WIND_FFT:
+	case WIND_REV_FFT:
+	case WIND_SDFT:
+		return 0;
+
+	default:
+		return 1;
+	}
+}
+
+static long
+gcd(long a, long b)
+{
+	long t;
+
+	while (b != 0) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+// Solves q[from]*produced == q[to]*consumed over the links between ordered
+// nodes for the least firings per pass of each connected part.  Nodes then
+// fire in order, each once its inputs got all of the pass's samples, so
+// the rings are sized here once.  Runs of pointwise firings become single
+// ones.  Sinks take whatever a pass brings on each input.  0 when the rates
+// can't balance.
+static int
+graph_schedule(void)
+{
+	int i, n, a, b, part, nparts, floats;
+	int ok = 1;
+	int changed;
+	long p, c, l, g;
+	long *num, *den;
+	int *parts;
+	struct node *node;
+	struct links *link;
+
+	n = 0;
+	list_foreach (wind_nodes, node)
+		node->mark = n++;
+
+	num = xmalloc(n * sizeof (long));
+	den = xmalloc(n * sizeof (long));
+	parts = xmalloc(n * sizeof (int));
+	memset(num, 0, n * sizeof (long));
+
+	// rational firings relative to the part's first node
+	nparts = 0;
+	for (i = 0; i < norder; ++i) {
+		if (num[order[i]->mark] != 0)
+			continue;
+
+		a = order[i]->mark;
+		num[a] = den[a] = 1;
+		parts[a] = ++nparts;
+
+		do {
+			changed = 0;
+
+			list_foreach (links, link) {
+				if (link->to->index == -1)
+					continue;
+
+				a = link->from->mark;
+				b = link->to->mark;
+				p = port_rate(link->from, 1);
+				c = port_rate(link->to, 0);
+
+				if (num[a] != 0 && num[b] == 0) {
+					num[b] = num[a] * p;
+					den[b] = den[a] * c;
+				}
+				else if (num[a] == 0 && num[b] != 0) {
+					SWAP(a, b);
+					num[b] = num[a] * c;
+					den[b] = den[a] * p;
+				}
+				else {
+					if (num[a] != 0 && num[a] * p * den[b] !=
+					    num[b] * c * den[a])
+						ok = 0;
+					continue;
+				}
+
+				g = gcd(num[b], den[b]);
+				num[b] /= g;
+				den[b] /= g;
+				parts[b] = parts[a];
+				changed = 1;
+			}
+		} while (changed && ok);
+	}
+
+	// the least integer firings of each part
+	for (part = 1; ok && part <= nparts; ++part) {
+		l = 1;
+		g = 0;
+
+		for (a = 0; a < n; ++a)
+			if (num[a] != 0 && parts[a] == part)
+				l = l / gcd(l, den[a]) * den[a];
+
+		for (a = 0; a < n; ++a)
+			if (num[a] != 0 && parts[a] == part)
+				g = gcd(g, num[a] * (l / den[a]));
+
+		for (a = 0; a < n; ++a) {
+			if (num[a] == 0 || parts[a] != part)
+				continue;
+
+			num[a] = num[a] * (l / den[a]) / g;
+			if (num[a] > STREAM_FIRES_MAX)
+				ok = 0;
+		}
+	}
+
+	// a mic takes a captured block per firing
+	stream_hop = stream_block;
+
+	list_foreach (wind_nodes, node) {
+		if (num[node->mark] == 0)
+			continue;
+
+		node->fires = node_blockable(node) ? 1 : num[node->mark];
+
+		if (node->type == WIND_GEN_MIC)
+			stream_hop = MAX(stream_hop, node->fires * stream_block);
+	}
+
+	if (stream_hop > MICBUF_SAMPLES)
+		ok = 0;
+
+	// a ring holds latency passes of samples
+	list_foreach (links, link) {
+		if (!ok || !ring_used(link))
+			continue;
+
+		a = link->from->mark;
+		b = link->to->mark;
+		floats = (link->view.type == CON_COMPLEX) ? 2 : 1;
+
+		p = port_rate(link->from, 1) *
+		    (node_blockable(link->from) ? num[a] : 1);
+		c = port_rate(link->to, 0) *
+		    (node_blockable(link->to) ? num[b] : 1);
+
+		if (node_sink(link->to))
+			c = num[a] * port_rate(link->from, 1);
+
+		ring_reserve(&link->ring, stream_latency * floats * num[a] *
+		    port_rate(link->from, 1));
+		link->ring.put = p * floats;
+		link->ring.take = c * floats;
+
+		link->view.samples = link->view.hop = c;
+	}
+
+	free(parts);
+	free(den);
+	free(num);
+
+	return ok;
+}
+
+// A pointwise node fuses into the pointwise node its output feeds, which
+// is then the only reader of it
+static void
+graph_fuse(void)
+{
+	int i;
+	struct node *node, *from;
+
+	list_foreach (wind_nodes, node) {
+		node->fuse_from = NULL;
+		node->fused = 0;
+	}
+
+	for (i = 0; i < norder; ++i) {
+		node = order[i];
+		if (!node_pointwise(node) || node->ilink[0] == NULL)
+			continue;
+
+		from = node->ilink[0]->from;
+		if (!node_pointwise(from))
+			continue;
+
+		node->fuse_from = from;
+		from->fused = 1;
+	}
+}
+
+// depth first from the sinks, so every node follows its inputs; the graph
+// has no cycles, link_add refuses them
+static void
+graph_compile(void)
+{
+	int i, j;
+	struct node *node;
+	struct links *link;
+
+	marks_clear();
+
+	order = xrealloc(order, nodecount * sizeof (struct node*));
+	norder = 0;
+
+	// streaming inputs read the link rings
+	list_foreach (links, link) {
+		link->view.type = link->from->out[link->fcon]->type;
+		link->to->inp[link->tcon] = stream_mode ? &link->view :
+		    link->from->out[link->fcon];
+	}
+
+	list_foreach (links, link)
+		if (node_sink(link->to))
+			compile_rec(link->from);
+
+	npred = xrealloc(npred, nodecount * sizeof (int));
+	nsucc = xrealloc(nsucc, nodecount * sizeof (int));
+	succ = xrealloc(succ, nodecount * sizeof (int*));
+	succbuf = xrealloc(succbuf, OCON_MAX * nodecount * sizeof (int));
+
+	// all inputs of an ordered node are ordered, the outputs may lead to
+	// nodes out of the order; no node has more than OCON_MAX outputs
+	for (i = 0; i < norder; ++i) {
+		node = order[i];
+		npred[i] = nsucc[i] = 0;
+		succ[i] = succbuf + OCON_MAX*i;
+
+		for (j = 0; j < node->icon; ++j)
+			if (node->ilink[j] != NULL)
+				++npred[i];
+
+		for (j = 0; j < node->ocon; ++j)
+			if (node->olink[j] != NULL &&
+			    node->olink[j]->to->index != -1)
+				succ[i][nsucc[i]++] = node->olink[j]->to->index;
+	}
+
+	graph_fuse();
+	graph_alloc();
+
+	// the menu reads it without the lock
+	if (stream_mode)
+		__atomic_store_n(&stream_ok, graph_schedule(),
+		    __ATOMIC_RELEASE);
+}
+
+static void
+snap_publish(struct snapshot *snap, struct connector *con)
+{
+	int b = snap->back;
+	int samples = 0;
+
+	if (con != NULL && con->type == CON_REAL)
+		samples = con->samples;
+
+	if (snap->size[b] < samples) {
+		snap->buf[b] = xrealloc(snap->buf[b], samples * sizeof (float));
+		snap->size[b] = samples;
+	}
+
+	if (samples > 0)
+		memcpy(snap->buf[b], con->buf, samples * sizeof (float));
+	snap->samples[b] = samples;
+
+	snap->back = __atomic_exchange_n(&snap->middle, b | SNAP_FRESH,
+	    __ATOMIC_ACQ_REL) & ~SNAP_FRESH;
+}
+
+// the newest complete frame, or the one read last time
+static float*
+snap_read(struct snapshot *snap, int *samples)
+{
+	if (__atomic_load_n(&snap->middle, __ATOMIC_ACQUIRE) & SNAP_FRESH)
+		snap->front = __atomic_exchange_n(&snap->middle, snap->front,
+		    __ATOMIC_ACQ_REL) & ~SNAP_FRESH;
+
+	*samples = snap->samples[snap->front];
+
+	return snap->buf[snap->front];
+}
+
+static void
+plots_publish(void)
+{
+	int i;
+	struct node *node;
+	struct links *link;
+
+	list_foreach (wind_nodes, node) {
+		if (node->type != WIND_PLOT)
+			continue;
+
+		// plots show the newest block queued to them
+		for (i = 0; stream_mode && i < node->icon; ++i) {
+			link = node->ilink[i];
+			if (link != NULL && ring_view(link, 1))
+				ring_pop(link);
+		}
+
+		if (!node_dirty(node))
+			continue;
+
+		for (i = 0; i < node->icon; ++i)
+			snap_publish(&node->snap[i], node->inp[i]);
+	}
+}
+
+// adds n samples at off into the pass's mix, returns its new length
+static int
+output_mix(const float *src, int off, int n, int len)
+{
+	int i;
+
+	if (off + n > mixsize) {
+		mixbuf = xrealloc(mixbuf, (off + n) * sizeof (float));
+		mixsize = off + n;
+	}
+
+	for (i = len; i < off + n; ++i)
+		mixbuf[i] = 0;
+
+	for (i = 0; i < n; ++i)
+		mixbuf[off + i] += src[i];
+
+	return MAX(len, off + n);
+}
+
+// Mixes what is new on the outputs' inputs into the playback ring.  A full
+// ring drops the mix, the engine never waits for the output.
+static void
+outputs_feed(void)
+{
+	int i, n, off;
+	int len = 0;
+	int target = 0;
+	uint64_t head = play_head;	// only written by the engine
+	struct node *node;
+	struct links *link;
+	struct connector *inp;
+
+	list_foreach (wind_nodes, node) {
+		if (node->type != WIND_OUTPUT)
+			continue;
+
+		target = MAX(target, node->out_latency);
+		link = node->ilink[0];
+		inp = node->inp[0];
+		off = 0;
+
+		// streaming queues every sample, windows bring hop new ones
+		if (link == NULL)
+			continue;
+		else if (stream_mode) {
+			while (ring_view(link, 0)) {
+				if (inp->type == CON_REAL)
+					len = output_mix(inp->buf, off,
+					    inp->samples, len);
+				off += inp->samples;
+				ring_pop(link);
+			}
+		}
+		else if (node_dirty(node) && inp->buf != NULL &&
+		    inp->type == CON_REAL) {
+			n = MIN(inp->hop, inp->samples);
+			len = output_mix(inp->buf + inp->samples - n, 0, n,
+			    len);
+		}
+	}
+
+	if (target > 0)
+		__atomic_store_n(&play_target, target * RATE / 1000,
+		    __ATOMIC_RELAXED);
+
+	if (len == 0 || __atomic_load_n(&play_fd, __ATOMIC_ACQUIRE) == -1)
+		return;
+
+	if (head + len - __atomic_load_n(&play_tail, __ATOMIC_ACQUIRE) >
+	    PLAYBUF_SAMPLES) {
+		__atomic_add_fetch(&out_stats.dropped, len, __ATOMIC_RELAXED);
+		return;
+	}
+
+	for (i = 0; i < len; ++i)
+		playbuf[(head + i) & (PLAYBUF_SAMPLES - 1)] = mixbuf[i];
+
+	__atomic_store_n(&play_head, head + len, __ATOMIC_RELEASE);
+}
+
+// runs the graph once per hop of captured samples, streaming sets it
+static void*
+engine(void *arg)
+{
+	int hop = MIC_HOP;
+
+	UNUSED(arg);
+
+	while (1) {
+		capture_wait(hop);
+
+		pthread_mutex_lock(&graph_lock);
+		signal_proc();
+		plots_publish();
+		outputs_feed();
+		hop = stream_mode ? stream_hop : MIC_HOP;
+		pthread_mutex_unlock(&graph_lock);
+	}
+
+	return NULL;
+}
+
+// Times the candidates next to the engine and the UI; plans are rebuilt
+// in place, so only the rebuild makes the engine wait
+static void*
+tune(void *arg)
+{
+	UNUSED(arg);
+
+	fft_autotune();
+
+	pthread_mutex_lock(&graph_lock);
+	fft_replan();
+	pthread_mutex_unlock(&graph_lock);
+
+	if (fft_wisdom_save(WISDOM_FILE) == -1)
+		warning("Can't save %s", WISDOM_FILE);
+
+	__atomic_store_n(&tuning, 0, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static int
+oss_init(void)
+{
+	int afmt, chnls, rate;
+
+	afmt = AFMT;
+	chnls = cap_chnls;
+	rate = RATE;
+
+	// the device answers with what it grants, the frames have as many
+	// channels; a file in place of the device fails here
+	if (SYSCALL(0, ioctl, oss_fd, SNDCTL_DSP_SPEED, &rate) == -1 ||
+	    SYSCALL(0, ioctl, oss_fd, SNDCTL_DSP_CHANNELS, &chnls) == -1 ||
+	    SYSCALL(0, ioctl, oss_fd, SNDCTL_DSP_SETFMT, &afmt) == -1)
+		return 1;
+
+	if (rate < RATE) {
+		fprintf(stderr, "Device doesn't support rate.\n");
+		return 1;
+	}
+	if (chnls < cap_chnls || chnls > PCM_CHNLS_MAX) {
+		fprintf(stderr, "Device doesn't support %d channel(s).\n",
+		    cap_chnls);
+		return 1;
+	}
+	if (afmt != AFMT) {
+		fprintf(stderr, "Device doesn't support format.\n");
+		return 1;
+	}
+
+	cap_chnls = chnls;
+
+	return 0;
+}
+
+int
+wind_init(void)
+{
+	int nthreads;
+	char *threads, *map, *chnls;
+	char *devname = OSS_DEVNAME;
+
+	wind_nodes = list_new(wind_nodes);
+
+	wind_nodes->type = WIND_MENU;
+	wind_nodes->name = "menu";
+
+	wind_nodes->x = 0;
+	wind_nodes->y = 0;
+	wind_nodes->h = 800;
+	wind_nodes->w = 250;
+
+	wind_nodes->icon = 0;
+	wind_nodes->ocon = 0;
+	wind_nodes->inp = NULL;
+	wind_nodes->out = NULL;
+	wind_nodes->ilink = NULL;
+	wind_nodes->olink = NULL;
+	wind_nodes->inp_version = NULL;
+
+	nodecount = 1;
+
+	if ((threads = getenv(THREADS_ENV)) == NULL ||
+	    (nthreads = atoi(threads)) <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	pool = pool_new(nthreads);
+	fft_set_pool(pool);
+
+	// missing wisdom only means default plans
+	fft_wisdom_load(WISDOM_FILE);
+
+	if ((chnls = getenv(CHNLS_ENV)) != NULL) {
+		cap_chnls = atoi(chnls);
+
+		if (cap_chnls < 1 || cap_chnls > PCM_CHNLS_MAX) {
+			warning("%s must be 1 to %d, capturing %d", CHNLS_ENV,
+			    PCM_CHNLS_MAX, CHNLS);
+			cap_chnls = CHNLS;
+		}
+	}
+
+	play_name = getenv(OUTPUT_ENV);
+
+	// a missing or unusable device leaves the mic silent, the graph
+	// still runs
+	oss_fd = open(devname, O_RDWR | O_NONBLOCK);
+	if (oss_fd != -1 && oss_init() != 0) {
+		warning("Can't set %s up, the mic stays silent", devname);
+		close(oss_fd);
+		oss_fd = -1;
+	}
+
+	// mapped capture is opt in, devices without it stay on read()
+	if (oss_fd != -1 && (map = getenv(MMAP_ENV)) != NULL && atoi(map) &&
+	    !capture_map())
+		warning("Can't map %s, capturing with read()", devname);
+
+	if (sem_init(&cap_sem, 0, 0) != 0)
+		error(1, "Can't create capture semaphore");
+
+	if (pthread_create(&capture_thread, NULL, capture, NULL) != 0)
+		error(1, "Can't create capture thread");
+
+	if (pthread_create(&engine_thread, NULL, engine, NULL) != 0)
+		error(1, "Can't create engine thread");
+
+	return 0;
+}
+
+void
+wind_output_stats(struct output_stats *stats)
+{
+	stats->underruns = __atomic_load_n(&out_stats.underruns,
+	    __ATOMIC_RELAXED);
+	stats->dropped = __atomic_load_n(&out_stats.dropped, __ATOMIC_RELAXED);
+}
+
+void
+wind_capture_stats(struct capture_stats *stats)
+{
+	stats->overruns = __atomic_load_n(&cap_stats.overruns,
+	    __ATOMIC_RELAXED);
+	stats->short_reads = __atomic_load_n(&cap_stats.short_reads,
+	    __ATOMIC_RELAXED);
+	stats->dropped = __atomic_load_n(&cap_stats.dropped, __ATOMIC_RELAXED);
+}
+
+static struct node*
+node_new(enum windtypes type)
+{
+	int i;
+	struct node *node;
+	enum contype otype = CON_REAL;
+
+	node = list_alloc_at_end(wind_nodes);
+
+	node->type = type;
+	node->x = node->y = 0;
+	node->h = 150;
+	node->w = 150;
+	node->inp = NULL;
+	node->out = NULL;
+	node->ilink = NULL;
+	node->olink = NULL;
+	node->mark = 0;
+	node->index = -1;
+	node->version = 1;
+	node->run_version = 0;
+	node->inp_version = NULL;
+	node->fires = 1;
+	node->firing = 0;
+
+	switch (type) {
+	case WIND_GEN_SIN:
+		node->name = "Sine wave generator";
+		node->h = 250;
+		node->w = 250;
+		node->icon = 0;
+		node->ocon = 1;
+
+		node->sine_samples = 512;
+		node->sine_phase = 0;
+		node->step = 1;
+		break;
+
+	case WIND_GEN_MIC:
+		node->name = "Microphone signal";
+		node->h = 250;
+		node->w = 250;
+		node->icon = 0;
+		node->ocon = cap_chnls;
+
+		node->mic_samples = 512;
+		node->mic_long = 0;
+		node->gain = 1.0;
+
+		node->rec_size = 0;
+		node->rec_pos = 0;
+		memset(node->rec, 0, sizeof (node->rec));
+		break;
+
+	case WIND_TEE:
+		node->name = "Tee";
+		node->icon = 1;
+		node->ocon = 2;
+		break;
+
+	case WIND_FFT:
+		node->name = "FFT";
+		node->icon = 1;
+		node->ocon = 1;
+		otype = CON_COMPLEX;
+
+		node->fft_size = FFT_SIZE;
+		break;
+
+	case WIND_REV_FFT:
+		node->name = "Reverse FFT";
+		node->icon = 1;
+		node->ocon = 1;
 
-			return;
+		node->fft_size = FFT_SIZE;
+		break;
 
-		case WIND_FFT:
-			conn_count = 2;
-			samples = alloca(2 * sizeof (int));
+	case WIND_SDFT:
+		node->name = "Sliding DFT";
+		node->w = 250;
+		node->icon = 1;
+		node->ocon = 1;
+		otype = CON_COMPLEX;
+
+		node->sdft_resync = SDFT_RESYNC;
+		node->sdft_size = FFT_SIZE;
+		node->sdft_age = 0;
+		node->sdft_n = 0;
+		node->sdft_re = node->sdft_im = NULL;
+		node->sdft_wr = node->sdft_wi = NULL;
+		node->sdft_hist = NULL;
+		break;
+
+	case WIND_SPLIT:
+		node->name = "Complex to Re/Im";
+		node->icon = 1;
+		node->ocon = 2;
+		break;
 
-			samples[0] = node->out[0]->samples;
+	case WIND_MERGE:
+		node->name = "Re/Im to complex";
+		node->icon = 2;
+		node->ocon = 1;
+		otype = CON_COMPLEX;
+		break;
 
-			link = find_link(NULL, node, -1, 0);
-			if (link != NULL) {
-				signal_proc_rec(link->from);
-				samples[0] = node->inp[0]->samples;
-				samples[0] = pow(2, (int)log2(samples[0]))/2;
-			}
+	case WIND_POLAR:
+		node->name = "Polar";
+		node->w = 250;
+		node->icon = 2;
+		node->ocon = 1;
 
-			samples[1] = samples[0];
+		node->polar_mode = POLAR_DB;
+		node->polar_fast = 0;
+		break;
 
-			break;
+	case WIND_DECIMATE:
+		node->name = "Decimate";
+		node->icon = 1;
+		node->ocon = 1;
 
-		case WIND_REV_FFT:
-			conn_count = 1;
-			samples = alloca(sizeof (int));
+		node->rate_factor = RATE_FACTOR;
+		break;
 
-			samples[0] = node->out[0]->samples;
+	case WIND_INTERP:
+		node->name = "Interpolate";
+		node->icon = 1;
+		node->ocon = 1;
 
-			link = find_link(NULL, node, -1, 0);
-			if (link != NULL) {
-				signal_proc_rec(link->from);
-				samples[0] = node->inp[0]->samples*2;
-			}
+		node->rate_factor = RATE_FACTOR;
+		break;
 
-			link = find_link(NULL, node, -1, 1);
-			if (link != NULL) {
-				signal_proc_rec(link->from);
-				samples[0] = MIN(samples[0], node->inp[1]->samples*2);
-			}
+	case WIND_GAIN:
+		node->name = "Gain";
+		node->icon = 1;
+		node->ocon = 1;
 
-			break;
+		node->amp = 1.0;
+		break;
 
-		case WIND_TEE:
-			conn_count = 2;
-			samples = alloca(2 * sizeof (int));
+	case WIND_CLAMP:
+		node->name = "Clamp";
+		node->icon = 1;
+		node->ocon = 1;
 
-			samples[0] = node->out[0]->samples;
+		node->limit = 1.0;
+		break;
 
-			link = find_link(NULL, node, -1, 0);
-			if (link != NULL) {
-				signal_proc_rec(link->from);
-				samples[0] = node->inp[0]->samples;
-			}
+	case WIND_PLOT:
+		node->name = "Plot";
+		node->h = 250;
+		node->w = 400;
+		node->icon = 4;
+		node->ocon = 0;
 
-			samples[1] = samples[0];
+		node->maxval =  1.0;
+		node->minval = -1.0;
 
-			break;
+		node->snap = xmalloc(node->icon * sizeof (struct snapshot));
+		memset(node->snap, 0, node->icon * sizeof (struct snapshot));
 
-		case WIND_GEN_MIC:
-			conn_count = 1;
-			samples = alloca(sizeof (int));
+		for (i = 0; i < node->icon; ++i) {
+			node->snap[i].back = 0;
+			node->snap[i].middle = 1;
+			node->snap[i].front = 2;
+		}
+		break;
 
-			samples[0] = samples[1] = node->mic_samples;
+	case WIND_OUTPUT:
+		node->name = "Audio output";
+		node->icon = 1;
+		node->ocon = 0;
 
-			break;
+		node->out_latency = OUT_LATENCY;
+		playback_begin();
+		break;
 
-		case WIND_GEN_SIN:
-			conn_count = 1;
-			samples = alloca(sizeof (int));
+	default:
+		node->icon = node->ocon = 0;
+		break;
+	}
 
-			samples[0] = samples[1] = node->sine_samples;
+	if (node->icon > 0) {
+		node->inp = xmalloc(node->icon * sizeof (struct connector*));
+		node->ilink = xmalloc(node->icon * sizeof (struct links*));
+		node->inp_version = xmalloc(node->icon * sizeof (unsigned));
 
-			break;
+		for (i = 0; i < node->icon; ++i) {
+			node->inp[i] = NULL;
+			node->ilink[i] = NULL;
+			node->inp_version[i] = 0;
+		}
 	}
 
-	for (i = 0; i < conn_count; ++i) {
-		node->out[i]->samples = samples[i];
-		bufsize = node->out[i]->bufsize;
-		buf = node->out[i]->buf;
-
-		if (bufsize < samples[i]) {
-			bufsize = samples[i];
-			buf = xrealloc(buf, bufsize * sizeof (float));
+	if (node->ocon > 0) {
+		node->out = xmalloc(node->ocon * sizeof (struct connector*));
+		node->olink = xmalloc(node->ocon * sizeof (struct links*));
 
-			node->out[i]->bufsize = bufsize;
-			node->out[i]->buf = buf;
+		for (i = 0; i < node->ocon; ++i) {
+			node->out[i] = con_new(otype);
+			node->olink[i] = NULL;
 		}
 	}
 
-	if (node->type == WIND_FFT)
-		fft_proc(node);
-	else if (node->type == WIND_REV_FFT)
-		rev_fft_proc(node);
-	else if (node->type == WIND_TEE)
-		tee_proc(node);
-	else if (node->type == WIND_GEN_MIC)
-		genmic(node);
-	else if (node->type == WIND_GEN_SIN)
-		gensin(node);
+	++nodecount;
 
-	node->processed = 1;
+	return node;
 }
 
 static void
-signal_proc(void)
+link_del(struct links *link)
 {
-	struct links *link;
-	struct node *node;
+	free(link->ring.buf);
 
-	list_foreach(wind_nodes, node)
-		node->processed = 0;
+	link->to->inp[link->tcon] = NULL;
+	link->to->ilink[link->tcon] = NULL;
+	++link->to->version;
+	link->from->olink[link->fcon] = NULL;
+	links = list_free(link);
 
-	list_foreach(links, link)
-		if (link->to->type == WIND_PLOT)
-			signal_proc_rec(link->from);
+	graph_compile();
 }
 
-int
-wind_init(void)
+// The link out of the conversion node link feeds, when a connector of
+// type no longer needs it there, or NULL
+static struct links*
+conv_stale(struct links *link, enum contype type)
 {
-	int afmt, chnls, rate;
-	char *devname = OSS_DEVNAME;
-
-	wind_nodes = list_new(wind_nodes);
+	struct node *conv = link->to;
 
-	wind_nodes->type = WIND_MENU;
-	wind_nodes->name = "menu";
+	if (conv->type == WIND_MERGE && type == CON_COMPLEX &&
+	    link->tcon == 0 && conv->ilink[1] == NULL)
+		return conv->olink[0];
 
-	wind_nodes->x = 0;
-	wind_nodes->y = 0;
-	wind_nodes->h = 400;
-	wind_nodes->w = 250;
+	if (conv->type == WIND_SPLIT && type == CON_REAL &&
+	    conv->olink[1] == NULL)
+		return conv->olink[0];
 
-	wind_nodes->icon = 0;
-	wind_nodes->ocon = 0;
-	wind_nodes->inp = NULL;
-	wind_nodes->out = NULL;
+	return NULL;
+}
 
-	nodecount = 1;
+// a connector has at most one link, a new one replaces the old ones on
+// both ends.  Links of mismatched types get a conversion node in between;
+// links closing a cycle are refused
+static int
+link_add(struct node *from, int fcon, struct node *to, int tcon)
+{
+	int i, ncon, retype;
+	struct links *link, *stale;
+	struct node *conv, *next;
+	enum contype otype = from->out[fcon]->type;
+	enum contype itype = inp_type(to, tcon);
+	enum contype ntype;
+
+	marks_clear();
+	if (feeds(to, from))
+		return -1;
 
-	// oss init
-	oss_fd = open(devname, O_RDWR);
-	if (oss_fd == -1)
-		return 0;
+	if (to->ilink[tcon] != NULL)
+		link_del(to->ilink[tcon]);
+	if (from->olink[fcon] != NULL)
+		link_del(from->olink[fcon]);
 
-	afmt = AFMT;
-	chnls = CHNLS;
-	rate = RATE;
+	if (itype != CON_ANY && itype != otype) {
+		conv = node_new((otype == CON_COMPLEX) ? WIND_SPLIT : WIND_MERGE);
+		conv->x = (from->x + from->w + to->x - conv->w) / 2;
+		conv->y = (from->y + to->y) / 2;
 
-	rate = SYSCALL(1, ioctl, oss_fd, SNDCTL_DSP_SPEED, &rate);
-	chnls = SYSCALL(1, ioctl, oss_fd, SNDCTL_DSP_CHANNELS, &chnls);
-	afmt = SYSCALL(1, ioctl, oss_fd, SNDCTL_DSP_SETFMT, &afmt);
+		link_add(from, fcon, conv, 0);
 
-	if (rate != 0 && rate < RATE) {
-		fprintf(stderr, "Device doesn't support rate.\n");
-		return 1;
-	}
-	if (chnls != 0 && chnls < CHNLS) {
-		fprintf(stderr, "Device doesn't support %d channel(s).\n", chnls);
-		return 1;
+		from = conv;
+		fcon = 0;
 	}
-	if (afmt != 0 && afmt < AFMT) {
-		fprintf(stderr, "Device doesn't support format.\n");
-		return 1;
-	}
-
-	return 0;
-}
-
-static void
-menu_content(struct nk_context *ctx, struct node *node)
-{
-	nk_layout_row_dynamic(ctx, 25, 1);
-	nk_label(ctx, "New windows:", NK_TEXT_LEFT);
 
-	if (nk_button_label(ctx, "Sine wave generator")) {
-		node = list_alloc_at_end(wind_nodes);
+	to->inp[tcon] = from->out[fcon];
 
-		node->type = WIND_GEN_SIN;
-		node->name = "Sine wave generator";
-
-		node->x = node->y = 0;
-		node->h = 250;
-		node->w = 250;
-		node->icon = 0;
-		node->ocon = 1;
-		node->sine_samples = 512;
+	retype = (to->type == WIND_TEE &&
+	    to->out[0]->type != from->out[fcon]->type);
+	if (to->type == WIND_TEE)
+		to->out[0]->type = to->out[1]->type = from->out[fcon]->type;
 
-		node->out = xmalloc(sizeof (struct connector*));
-		node->out[0] = xmalloc(sizeof (struct connector));
-		memset(node->out[0], 0, sizeof (struct connector));
+	link = list_alloc_at_end(links);
+	links = list_get_head(link);
+	link->from = from;
+	link->fcon = fcon;
+	link->to = to;
+	link->tcon = tcon;
 
-		node->step = 1;
+	memset(&link->ring, 0, sizeof (struct ring));
+	memset(&link->view, 0, sizeof (struct connector));
+	link->view.mem = &link->view.own;
 
-		++nodecount;
-	}
-	if (nk_button_label(ctx, "Microphone signal")) {
-		node = list_alloc_at_end(wind_nodes);
+	from->olink[fcon] = link;
+	to->ilink[tcon] = link;
+	++to->version;
 
-		node->type = WIND_GEN_MIC;
-		node->name = "Microphone signal";
+	graph_compile();
 
-		node->x = node->y = 0;
-		node->h = 250;
-		node->w = 250;
-		node->icon = 0;
-		node->ocon = 1;
-		node->mic_samples = 512;
+	// The tee's links were made for its old type: relinking converts
+	// them again, and conversions the new type made useless are left
+	// out of the path.  Tees further down retype the same way.
+	for (i = 0; retype && i < to->ocon; ++i) {
+		if ((link = to->olink[i]) == NULL)
+			continue;
 
-		node->inp = NULL;
-		node->out = xmalloc(sizeof (struct connector*));
-		node->out[0] = xmalloc(sizeof (struct connector));
-		memset(node->out[0], 0, sizeof (struct connector));
+		next = link->to;
+		ncon = link->tcon;
+		ntype = inp_type(next, ncon);
 
-		node->gain = 1.0;
+		if ((stale = conv_stale(link, otype)) != NULL) {
+			next = stale->to;
+			ncon = stale->tcon;
+		}
+		else if ((ntype == CON_ANY || ntype == otype) &&
+		    (next->type != WIND_TEE || next->out[0]->type == otype))
+			continue;
 
-		++nodecount;
+		link_add(to, i, next, ncon);
 	}
-	if (nk_button_label(ctx, "Tee")) {
-		node = list_alloc_at_end(wind_nodes);
 
-		node->type = WIND_TEE;
-		node->name = "Tee";
+	return 0;
+}
 
-		node->x = node->y = 0;
-		node->h = 150;
-		node->w = 150;
-		node->icon = 1;
-		node->ocon = 2;
+// a new mode reruns every node, the rings restart
+static void
+stream_set(int mode, int block, int latency)
+{
+	struct node *node;
 
-		node->inp = xmalloc(sizeof (struct connector*));
-		node->inp[0] = NULL;
-		node->out = xmalloc(2 * sizeof (struct connector*));
-		node->out[0] = xmalloc(sizeof (struct connector));
-		memset(node->out[0], 0, sizeof (struct connector));
-		node->out[1] = xmalloc(sizeof (struct connector));
-		memset(node->out[1], 0, sizeof (struct connector));
+	pthread_mutex_lock(&graph_lock);
 
-		++nodecount;
+	if (mode != stream_mode) {
+		list_foreach (wind_nodes, node)
+			++node->version;
 	}
-	if (nk_button_label(ctx, "FFT")) {
-		node = list_alloc_at_end(wind_nodes);
 
-		node->type = WIND_FFT;
-		node->name = "FFT";
+	stream_mode = mode;
+	stream_block = block;
+	stream_latency = latency;
+	graph_compile();
 
-		node->x = node->y = 0;
-		node->h = 150;
-		node->w = 150;
-		node->icon = 1;
-		node->ocon = 2;
+	pthread_mutex_unlock(&graph_lock);
+}
+
+static void
+menu_content(struct nk_context *ctx, struct node *node)
+{
+	char text[512];
+	struct capture_stats stats;
+	struct output_stats ostats;
+	enum windtypes type = WIND_MENU;
+	int mode = stream_mode;
+	int block = stream_block;
+	int latency = stream_latency;
 
-		node->inp = xmalloc(sizeof (struct connector*));
-		node->inp[0] = NULL;
-		node->out = xmalloc(2 * sizeof (struct connector*));
-		node->out[0] = xmalloc(sizeof (struct connector));
-		memset(node->out[0], 0, sizeof (struct connector));
-		node->out[1] = xmalloc(sizeof (struct connector));
-		memset(node->out[1], 0, sizeof (struct connector));
+	UNUSED(node);
 
-		++nodecount;
+	nk_layout_row_dynamic(ctx, 25, 1);
+	nk_label(ctx, "New windows:", NK_TEXT_LEFT);
+
+	if (nk_button_label(ctx, "Sine wave generator"))
+		type = WIND_GEN_SIN;
+	if (nk_button_label(ctx, "Microphone signal"))
+		type = WIND_GEN_MIC;
+	if (nk_button_label(ctx, "Tee"))
+		type = WIND_TEE;
+	if (nk_button_label(ctx, "FFT"))
+		type = WIND_FFT;
+	if (nk_button_label(ctx, "Reverse FFT"))
+		type = WIND_REV_FFT;
+	if (nk_button_label(ctx, "Sliding DFT"))
+		type = WIND_SDFT;
+	if (nk_button_label(ctx, "Complex to Re/Im"))
+		type = WIND_SPLIT;
+	if (nk_button_label(ctx, "Re/Im to complex"))
+		type = WIND_MERGE;
+	if (nk_button_label(ctx, "Polar"))
+		type = WIND_POLAR;
+	if (nk_button_label(ctx, "Decimate"))
+		type = WIND_DECIMATE;
+	if (nk_button_label(ctx, "Interpolate"))
+		type = WIND_INTERP;
+	if (nk_button_label(ctx, "Gain"))
+		type = WIND_GAIN;
+	if (nk_button_label(ctx, "Clamp"))
+		type = WIND_CLAMP;
+	if (nk_button_label(ctx, "Plot"))
+		type = WIND_PLOT;
+	if (nk_button_label(ctx, "Audio output"))
+		type = WIND_OUTPUT;
+
+	if (type != WIND_MENU) {
+		pthread_mutex_lock(&graph_lock);
+		node_new(type);
+		pthread_mutex_unlock(&graph_lock);
 	}
-	if (nk_button_label(ctx, "Reverse FFT")) {
-		node = list_alloc_at_end(wind_nodes);
 
-		node->type = WIND_REV_FFT;
-		node->name = "Reverse FFT";
+	// tunes the sizes the graph has used so far
+	if (__atomic_load_n(&tuning, __ATOMIC_ACQUIRE))
+		nk_label(ctx, "Tuning FFT...", NK_TEXT_CENTERED);
+	else if (nk_button_label(ctx, "Autotune FFT")) {
+		__atomic_store_n(&tuning, 1, __ATOMIC_RELEASE);
 
-		node->x = node->y = 0;
-		node->h = 150;
-		node->w = 150;
-		node->icon = 2;
-		node->ocon = 1;
+		if (pthread_create(&tune_thread, NULL, tune, NULL) != 0) {
+			warning("Can't create autotune thread");
+			__atomic_store_n(&tuning, 0, __ATOMIC_RELEASE);
+		}
+		else
+			pthread_detach(tune_thread);
+	}
 
-		node->inp = xmalloc(2 * sizeof (struct connector*));
-		node->inp[0] = NULL;
+	nk_checkbox_label(ctx, "Streaming", &mode);
+	if (stream_mode && !__atomic_load_n(&stream_ok, __ATOMIC_ACQUIRE))
+		nk_label(ctx, "Rates don't balance", NK_TEXT_LEFT);
 
-		node->out = xmalloc(sizeof (struct connector*));
-		node->out[0] = xmalloc(sizeof (struct connector));
-		memset(node->out[0], 0, sizeof (struct connector));
-		node->out[1] = xmalloc(sizeof (struct connector));
-		memset(node->out[0], 0, sizeof (struct connector));
+	nk_layout_row_dynamic(ctx, 15, 2);
+	sprintf(text, "Block: %d", block);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	nk_slider_int(ctx, 16, &block, MICBUF_SAMPLES, 16);
 
-		++nodecount;
-	}
-	if (nk_button_label(ctx, "Plot")) {
-		node = list_alloc_at_end(wind_nodes);
+	sprintf(text, "Latency: %d passes", latency);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	nk_slider_int(ctx, 1, &latency, STREAM_LATENCY_MAX, 1);
 
-		node->type = WIND_PLOT;
-		node->name = "Plot";
+	if (mode != stream_mode || block != stream_block ||
+	    latency != stream_latency)
+		stream_set(mode, block, latency);
 
-		node->x = node->y = 0;
-		node->h = 250;
-		node->w = 400;
-		node->icon = 4;
-		node->ocon = 0;
+	wind_capture_stats(&stats);
 
-		node->inp = xmalloc(4 * sizeof (struct connector*));
-		node->inp[0] = NULL;
-		node->inp[1] = NULL;
-		node->inp[2] = NULL;
-		node->inp[3] = NULL;
+	nk_layout_row_dynamic(ctx, 15, 1);
+	sprintf(text, "Overruns: %lu, short reads: %lu", stats.overruns,
+	    stats.short_reads);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	sprintf(text, "Dropped samples: %lu", stats.dropped);
+	nk_label(ctx, text, NK_TEXT_LEFT);
 
-		node->maxval =  1.0;
-		node->minval = -1.0;
+	wind_output_stats(&ostats);
 
-		++nodecount;
-	}
+	sprintf(text, "Output underruns: %lu, dropped: %lu",
+	    ostats.underruns, ostats.dropped);
+	nk_label(ctx, text, NK_TEXT_LEFT);
 }
 
 static void
@@ -615,69 +2934,194 @@ gensin_content(struct nk_context *ctx, struct node *node)
 
 	sprintf(text, "Frequency: %.2f", node->step);
 	nk_label(ctx, text, NK_TEXT_LEFT);
-	nk_slider_float(ctx, 0, &node->step, 10, 0.01);
+	if (nk_slider_float(ctx, 0, &node->step, 10, 0.01))
+		++node->version;
 
 	sprintf(text, "Samples: %d", node->sine_samples);
 	nk_label(ctx, text, NK_TEXT_LEFT);
-	nk_slider_int(ctx, 0, &node->sine_samples, 4096, 16);
+	if (nk_slider_int(ctx, 0, &node->sine_samples, 4096, 16))
+		++node->version;
 }
 
 static void
 genmic_content(struct nk_context *ctx, struct node *node)
 {
+	int bits;
 	char text[512];
 
 	nk_layout_row_dynamic(ctx, 15, 2);
 	sprintf(text, "Gain: %.2f", node->gain);
 	nk_label(ctx, text, NK_TEXT_LEFT);
-	nk_slider_float(ctx, 0, &node->gain, 5, 0.01);
+	if (nk_slider_float(ctx, 0, &node->gain, 5, 0.01))
+		++node->version;
+
+	sprintf(text, "Samples: %d", node->mic_samples);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	if (nk_slider_int(ctx, 16, &node->mic_samples, MICBUF_SAMPLES, 16))
+		++node->version;
+
+	// a power of two past MICBUF_SAMPLES, for the large transforms;
+	// streaming keeps its blocks
+	bits = (node->mic_long != 0) ? node->mic_long : MIC_LONG_MIN - 1;
+	if (bits < MIC_LONG_MIN)
+		sprintf(text, "Long window: off");
+	else
+		sprintf(text, "Long window: %d", 1 << bits);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	if (nk_slider_int(ctx, MIC_LONG_MIN - 1, &bits, MIC_LONG_MAX, 1)) {
+		node->mic_long = (bits < MIC_LONG_MIN) ? 0 : bits;
+		++node->version;
+	}
+}
+
+// rates only change between passes, the schedule follows them
+static void
+rate_set(struct node *node, int *rate, int value)
+{
+	pthread_mutex_lock(&graph_lock);
+	*rate = value;
+	++node->version;
+	graph_compile();
+	pthread_mutex_unlock(&graph_lock);
+}
+
+static void
+size_content(struct nk_context *ctx, struct node *node, int *size)
+{
+	char text[512];
+	int value = *size;
+
+	nk_layout_row_dynamic(ctx, 15, 2);
+	sprintf(text, "Stream size: %d", value);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	nk_slider_int(ctx, 16, &value, MICBUF_SAMPLES, 16);
+
+	if (value != *size)
+		rate_set(node, size, value);
+}
+
+static void
+sdft_content(struct nk_context *ctx, struct node *node)
+{
+	char text[512];
+
+	nk_layout_row_dynamic(ctx, 15, 2);
+	sprintf(text, "Resync: %d frames", node->sdft_resync);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	if (nk_slider_int(ctx, 1, &node->sdft_resync, 1000, 1))
+		++node->version;
+
+	size_content(ctx, node, &node->sdft_size);
+}
+
+static void
+factor_content(struct nk_context *ctx, struct node *node)
+{
+	char text[512];
+	int factor = node->rate_factor;
+
+	nk_layout_row_dynamic(ctx, 15, 2);
+	sprintf(text, "Factor: %d", factor);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	nk_slider_int(ctx, 1, &factor, RATE_FACTOR_MAX, 1);
+
+	if (factor != node->rate_factor)
+		rate_set(node, &node->rate_factor, factor);
+}
+
+static void
+gain_content(struct nk_context *ctx, struct node *node)
+{
+	char text[512];
+
+	nk_layout_row_dynamic(ctx, 15, 2);
+	sprintf(text, "Gain: %.2f", node->amp);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	if (nk_slider_float(ctx, 0, &node->amp, 10, 0.01))
+		++node->version;
+}
+
+static void
+clamp_content(struct nk_context *ctx, struct node *node)
+{
+	char text[512];
+
+	nk_layout_row_dynamic(ctx, 15, 2);
+	sprintf(text, "Limit: %.2f", node->limit);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	if (nk_slider_float(ctx, 0, &node->limit, 2, 0.01))
+		++node->version;
+}
+
+static void
+polar_content(struct nk_context *ctx, struct node *node)
+{
+	int i;
+	int mode;
+	const char *modes[POLAR_MODES];
+
+	for (i = 0; i < POLAR_MODES; ++i)
+		modes[i] = polar_mode_name(i);
+
+	nk_layout_row_dynamic(ctx, 25, 2);
+	mode = node->polar_mode;
+	nk_combobox(ctx, modes, POLAR_MODES, &node->polar_mode, 25,
+	    nk_vec2(120, 150));
+	if (node->polar_mode != mode)
+		++node->version;
+
+	if (nk_checkbox_label(ctx, "Fast", &node->polar_fast))
+		++node->version;
 }
 
 static void
 plot_content(struct nk_context *ctx, struct node *node)
 {
-	int i, j;
+	int i, j, k;
 	char text[512];
 	int max_samples = 64;
+	int stride, points;
+	float *bufs[4];
+	int samples[4];
 
+	// complex and unlinked inputs have empty snapshots
 	for (i = 0; i < 4; ++i) {
-		if (node->inp[i] == NULL)
-			continue;
-
-		max_samples = MAX(max_samples, node->inp[i]->samples);
+		bufs[i] = snap_read(&node->snap[i], &samples[i]);
+		max_samples = MAX(max_samples, samples[i]);
 	}
 
+	stride = (max_samples + PLOT_POINTS - 1) / PLOT_POINTS;
+	points = (max_samples + stride - 1) / stride;
+
 	nk_layout_row_dynamic(ctx, 100, 1);
 	if (nk_chart_begin_colored(ctx, NK_CHART_LINES_NO_RECT,
-	    nk_rgb(0xFF,0,0), nk_rgb(0,0,0), max_samples,
+	    nk_rgb(0xFF,0,0), nk_rgb(0,0,0), points,
 	    node->minval, node->maxval)) {
 		nk_chart_add_slot_colored(ctx, NK_CHART_LINES_NO_RECT,
-		    nk_rgb(0,0xFF,0), nk_rgb(0,0,0), max_samples,
+		    nk_rgb(0,0xFF,0), nk_rgb(0,0,0), points,
 		    node->minval, node->maxval);
 		nk_chart_add_slot_colored(ctx, NK_CHART_LINES_NO_RECT,
-		    nk_rgb(0,0,0xFF), nk_rgb(0,0,0), max_samples,
+		    nk_rgb(0,0,0xFF), nk_rgb(0,0,0), points,
 		    node->minval, node->maxval);
 		nk_chart_add_slot_colored(ctx, NK_CHART_LINES_NO_RECT,
-		    nk_rgb(0xFF,0xFF,0), nk_rgb(0,0,0), max_samples,
+		    nk_rgb(0xFF,0xFF,0), nk_rgb(0,0,0), points,
 		    node->minval, node->maxval);
 
 		for (i = 0; i < 4; ++i) {
-			for (j = 0; j < max_samples; ++j) {
-				float *buf;
+			for (j = 0; j < points; ++j) {
+				float *buf = bufs[i];
 
-				if (node->inp[i] == NULL || j >= node->inp[i]->samples) {
+				if ((k = j * stride) >= samples[i]) {
 					nk_chart_push_slot(ctx, 0, i);
 					continue;
 				}
 
-				buf = node->inp[i]->buf;
-
-				if (buf[j] >= node->maxval)
+				if (buf[k] >= node->maxval)
 					nk_chart_push_slot(ctx, node->maxval, i);
-				else if (buf[j] <= node->minval)
+				else if (buf[k] <= node->minval)
 					nk_chart_push_slot(ctx, node->minval, i);
 				else
-					nk_chart_push_slot(ctx, buf[j], i);
+					nk_chart_push_slot(ctx, buf[k], i);
 			}
 		}
 	}
@@ -693,6 +3137,19 @@ plot_content(struct nk_context *ctx, struct node *node)
 	node->minval = -node->maxval;
 }
 
+// the latency only paces the playback thread, the graph doesn't rerun
+static void
+output_content(struct nk_context *ctx, struct node *node)
+{
+	char text[512];
+
+	nk_layout_row_dynamic(ctx, 15, 2);
+	sprintf(text, "Latency: %d ms", node->out_latency);
+	nk_label(ctx, text, NK_TEXT_LEFT);
+	nk_slider_int(ctx, OUT_LATENCY_MIN, &node->out_latency,
+	    OUT_LATENCY_MAX, 10);
+}
+
 int
 wind_draw(struct nk_context *ctx)
 {
@@ -704,8 +3161,6 @@ wind_draw(struct nk_context *ctx)
 	    NK_WINDOW_BORDER | NK_WINDOW_TITLE;// | NK_WINDOW_CLOSABLE;
 	struct links *link;
 
-	set_micbuf();
-
 	canvas = nk_window_get_canvas(ctx);
 	total_space = nk_window_get_content_region(ctx);
 	nk_layout_space_begin(ctx, NK_STATIC, total_space.h, nodecount);
@@ -729,14 +3184,40 @@ wind_draw(struct nk_context *ctx)
 			break;
 
 		case WIND_TEE:
+		case WIND_SPLIT:
+		case WIND_MERGE:
+			break;
+
 		case WIND_FFT:
 		case WIND_REV_FFT:
+			size_content(ctx, node, &node->fft_size);
+			break;
+
+		case WIND_DECIMATE:
+		case WIND_INTERP:
+			factor_content(ctx, node);
+			break;
+
+		case WIND_GAIN:
+			gain_content(ctx, node);
+			break;
+
+		case WIND_CLAMP:
+			clamp_content(ctx, node);
 			break;
 
 		case WIND_GEN_MIC:
 			genmic_content(ctx, node);
 			break;
 
+		case WIND_SDFT:
+			sdft_content(ctx, node);
+			break;
+
+		case WIND_POLAR:
+			polar_content(ctx, node);
+			break;
+
 		case WIND_GEN_SIN:
 			gensin_content(ctx, node);
 			break;
@@ -744,6 +3225,10 @@ wind_draw(struct nk_context *ctx)
 		case WIND_PLOT:
 			plot_content(ctx, node);
 			break;
+
+		case WIND_OUTPUT:
+			output_content(ctx, node);
+			break;
 		}
 
 		nk_group_end(ctx);
@@ -765,13 +3250,10 @@ wind_draw(struct nk_context *ctx)
 			// start linking process
 			if (nk_input_has_mouse_click_down_in_rect(&ctx->input,
 			    NK_BUTTON_LEFT, circle, 1)) {
-				list_foreach (links, link) {
-					if (link->from == node && link->fcon == i) {
-						link->to->inp[link->tcon] = NULL;
-						links = list_free(link);
-						break;
-					}
-				}
+				pthread_mutex_lock(&graph_lock);
+				if (node->olink[i] != NULL)
+					link_del(node->olink[i]);
+				pthread_mutex_unlock(&graph_lock);
 
 				linking.node = node;
 				linking.slot = i;
@@ -803,20 +3285,9 @@ wind_draw(struct nk_context *ctx)
 			if (nk_input_is_mouse_released(&ctx->input, NK_BUTTON_LEFT) &&
 			    nk_input_is_mouse_hovering_rect(&ctx->input, circle) &&
 			    linking.node != node) {
-				list_foreach (links, link)
-					if (link->to == node && link->tcon == i)
-						links = list_free(link);
-
-				node->inp[i] = linking.node->out[linking.slot];
-
-				link = list_alloc_at_end(links);
-				links = list_get_head(link);
-				link->from = linking.node;
-				link->fcon = linking.slot;
-				link->to = node;
-				link->tcon = i;
-
-				links = (links == NULL) ? link : links;
+				pthread_mutex_lock(&graph_lock);
+				link_add(linking.node, linking.slot, node, i);
+				pthread_mutex_unlock(&graph_lock);
 
 				linking.node = NULL;
 				linking.slot = 0;
@@ -847,7 +3318,5 @@ wind_draw(struct nk_context *ctx)
 	}
 	nk_layout_space_end(ctx);
 
-	signal_proc();
-
 	return 0;
 }